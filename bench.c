@@ -0,0 +1,137 @@
+/* Throughput benchmarks for the formatting paths of `hexy()`, see
+ * `make bench`. Each configuration is run over buffers from 1 KiB up
+ * to the maximum size given on the command line (the default is 16 MiB,
+ * up to 1 GiB is allowed), with output going to a sink that only counts
+ * bytes so only formatting is measured. Small buffers are dumped repeatedly
+ * until enough time has passed to get a stable number. Results are given
+ * in MB/s and ns/byte of input, the output is meant to be compared between
+ * runs, so keep the machine and flags the same when doing so. */
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* for `clock_gettime` */
+#endif
+#define HEXY_IMPLEMENTATION
+#define HEXY_EXTERN static inline
+#define HEXY_API HEXY_EXTERN
+#include "hexy.h"
+#include <time.h>
+
+#define BENCH_MIN_SIZE (1024ul)
+#define BENCH_MAX_SIZE (1024ul * 1024ul * 1024ul)
+#define BENCH_MIN_TIME (0.25) /* seconds to run each configuration and size for, at least */
+
+typedef struct {
+	const char *name;
+	int base, group, format;
+	bool chars_off, raw, file, color;
+} bench_t;
+
+static const bench_t benches[] = {
+	{ .name = "base 16",         .base = 16, .group = 1, },
+	{ .name = "base 10",         .base = 10, .group = 1, },
+	{ .name = "base 8",          .base =  8, .group = 1, },
+	{ .name = "base 2",          .base =  2, .group = 1, },
+	{ .name = "group 2",         .base = 16, .group = 2, },
+	{ .name = "group 4",         .base = 16, .group = 4, },
+	{ .name = "group 8",         .base = 16, .group = 8, },
+	{ .name = "chars off",       .base = 16, .group = 1, .chars_off = true, },
+	{ .name = "raw (-R)",        .base = 16, .group = 1, .raw = true, },
+	{ .name = "format c",        .base = 16, .group = 1, .format = HEXY_FORMAT_C_E, },
+	{ .name = "format json",     .base = 16, .group = 1, .format = HEXY_FORMAT_JSON_E, },
+	{ .name = "format plain",    .base = 16, .group = 1, .format = HEXY_FORMAT_PLAIN_E, },
+	{ .name = "format od",       .base = 16, .group = 1, .format = HEXY_FORMAT_OD_E, },
+	{ .name = "color",           .base = 16, .group = 1, .color = true, },
+	{ .name = "color, base 8",   .base =  8, .group = 1, .color = true, },
+	{ .name = "file",            .base = 16, .group = 1, .file = true, },
+	{ .name = "file, raw (-R)",  .base = 16, .group = 1, .raw = true, .file = true, },
+};
+
+static double bench_now(void) {
+#if defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+#endif
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static int bench_sink(void *out, const char *buf, size_t length) {
+	(void)buf;
+	*(uint64_t*)out += length;
+	return length;
+}
+
+static int bench_sink_put(void *out, int ch) {
+	*(uint64_t*)out += 1;
+	return ch;
+}
+
+static int bench_run(const bench_t *b, uint8_t *data, size_t size, FILE *file, uint64_t *wrote) {
+	hexy_buffer_t in = { .b = data, .length = size, };
+	hexy_io_t io = {
+		.get = hexy_buffer_get, .put = bench_sink_put, .in = &in, .out = wrote,
+		.read_block = hexy_buffer_read, .write_block = bench_sink,
+	};
+	if (b->file) {
+		rewind(file);
+		io.get = hexy_file_get;
+		io.read_block = hexy_file_read;
+		io.in = file;
+	}
+	hexy_t h = {
+		.io = io,
+		.length = size, /* the file holds `max` bytes */
+		.chars_off = b->chars_off || b->raw, .addresses_off = b->raw, .newlines_off = b->raw,
+		.color_on = b->color,
+		.base = b->base, .group = b->group, .format = b->format,
+	};
+	return hexy(&h);
+}
+
+int main(int argc, char **argv) {
+	unsigned long max = 16ul * 1024ul * 1024ul;
+	if (argc > 2 || (argc == 2 && sscanf(argv[1], "%lu", &max) != 1)) {
+		(void)fprintf(stderr, "usage: %s [maximum-buffer-size]\n", argv[0]);
+		return 1;
+	}
+	max = HEXY_MAX(HEXY_MIN(max, BENCH_MAX_SIZE), BENCH_MIN_SIZE);
+	uint8_t *data = (uint8_t*)malloc(max);
+	if (!data) {
+		(void)fprintf(stderr, "could not allocate %lu bytes\n", max);
+		return 1;
+	}
+	uint32_t x = 2463534242u; /* xorshift32, mostly random with some text */
+	for (unsigned long i = 0; i < max; i++) {
+		x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+		data[i] = (i / 64) & 1 ? (x & 0xff) : ' ' + (x % 95);
+	}
+	FILE *file = tmpfile();
+	if (!file || fwrite(data, 1, max, file) != max || fflush(file) < 0) {
+		(void)fprintf(stderr, "could not create temporary file\n");
+		return 1;
+	}
+
+	(void)printf("%-16s %12s %12s %10s %10s\n", "config", "size", "output", "MB/s", "ns/byte");
+	for (size_t i = 0; i < HEXY_NELEMS(benches); i++) {
+		for (unsigned long size = BENCH_MIN_SIZE; size <= max; size *= 16) {
+			uint64_t wrote = 0, done = 0;
+			double elapsed = 0;
+			const double start = bench_now();
+			do {
+				if (bench_run(&benches[i], data, size, file, &wrote) < 0) {
+					(void)fprintf(stderr, "%s failed\n", benches[i].name);
+					return 1;
+				}
+				done += size;
+				elapsed = bench_now() - start;
+			} while (elapsed < BENCH_MIN_TIME);
+			elapsed = HEXY_MAX(elapsed, 1e-9);
+			(void)printf("%-16s %12lu %12lu %10.1f %10.3f\n", benches[i].name, size,
+				(unsigned long)(wrote / (done / size)), (done / 1e6) / elapsed, (elapsed * 1e9) / done);
+			if (size > (max / 16))
+				break;
+		}
+	}
+	(void)fclose(file);
+	free(data);
+	return 0;
+}
@@ -0,0 +1,712 @@
+/* Differential fuzzing and throughput checks for `hexy()`, see `make fuzz`.
+ *
+ * Each input is split into a configuration (base, address base, group,
+ * columns, flags, separators, format, offsets and limits) and the data to
+ * dump. The data is dumped a byte at a time with only `get` and `put`,
+ * which is the reference, and then through every other way of getting a
+ * dump out of the library: block I/O with the specialized renderers, the
+ * generic renderer, `hexy_feed` in pieces, `hexy_parallel`, and windows of
+ * `hexy_rows` with and without a cache. All of them have to produce the
+ * same output. Hex-dumps are also checked against a dump made here from
+ * first principles (by long division, without the digit tables, dividers
+ * or SIMD kernels), colour is checked by removing the escapes, and dumps
+ * in the default layout are turned back into binary with `hexy_undump`.
+ * The SIMD kernels and dividers are checked against scalar code, and
+ * `hexy_unescape` and `hexy_getopt` are given the data as strings.
+ *
+ * Built with `-DFUZZ_LIBFUZZER` this provides `LLVMFuzzerTestOneInput` for
+ * libFuzzer (`make libfuzzer`), otherwise `main` makes random inputs from
+ * a seed and runs any files given to it, such as inputs saved by libFuzzer
+ * or a failure saved by a previous run. With `-p file` the throughput of a
+ * fixed set of configurations is measured and compared with the numbers in
+ * that file (written if it does not exist), a configuration that is slower
+ * by more than the tolerance fails the run just as a wrong output does.
+ * Each number is the best of `FUZZ_PERF_RUNS` dumps, which still moves by
+ * up to half between runs on a busy machine, so the default tolerance of
+ * `FUZZ_PERF_TOLERANCE` only catches large regressions, use `bench.c` and
+ * a lower `-T` on a quiet machine for anything finer. */
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* for `clock_gettime` */
+#endif
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(HEXY_NO_THREADS)
+#define HEXY_THREADS /* so `hexy_parallel` is checked as well */
+#endif
+#define HEXY_IMPLEMENTATION
+#define HEXY_EXTERN static inline
+#define HEXY_API HEXY_EXTERN
+#include "hexy.h"
+#include <time.h>
+
+#define FUZZ_MAX_INPUT (16384ul)  /* default largest data made by the driver, enough for several `hexy_parallel` chunks */
+#define FUZZ_FAILURE "fuzz-failure.bin" /* where the driver saves an input that fails */
+#define FUZZ_PERF_SIZE (4ul * 1024ul * 1024ul) /* bytes dumped by each throughput check */
+#define FUZZ_PERF_RUNS (11)       /* the best of this many runs is taken */
+#define FUZZ_PERF_TOLERANCE (50)  /* default percentage slower than recorded that fails, above the noise */
+
+typedef struct {
+	const uint8_t *b;
+	size_t length, used;
+} fuzz_source_t; /* the input, taken from the front a byte at a time for the configuration */
+
+typedef struct {
+	hexy_t h;          /* configuration, without any I/O */
+	int threads;       /* for `hexy_parallel` */
+	size_t chunk;      /* most bytes given to `hexy_feed` at a time */
+	uint64_t window;   /* rows in each `hexy_rows` window */
+	bool defaults,     /* the separators are the defaults */
+	     cached;       /* `hexy_rows` uses a cache */
+} fuzz_config_t;
+
+enum { /* ways of dumping compared against `FUZZ_BYTES_E` */
+	FUZZ_BYTES_E,      /* `get` and `put` only, the reference */
+	FUZZ_BLOCKS_E,     /* block I/O, with a specialized renderer if there is one */
+	FUZZ_GENERIC_E,    /* block I/O, always with the generic renderer */
+	FUZZ_PUSH_E,       /* `hexy_begin`, `hexy_feed` and `hexy_finish` */
+	FUZZ_PARALLEL_E,   /* `hexy_parallel` */
+	FUZZ_ROWS_E,       /* `hexy_rows`, one window after another, without squeezing */
+	FUZZ_ENGINES_E,
+};
+
+static const char *fuzz_engines[] = { "bytes", "blocks", "generic", "push", "parallel", "rows", };
+
+static const char *fuzz_seps[] = { /* no escape character, so colour can be removed from the output */
+	"", " ", "  ", "|", ":", ": ", "\\t", ",", "---", "\\n", "\\x7f", "\\\\", "[", "]", "  |", "|\\n",
+};
+
+static unsigned fuzz_byte(fuzz_source_t *s) {
+	return s->used < s->length ? s->b[s->used++] : 0;
+}
+
+static uint64_t fuzz_number(fuzz_source_t *s, int bytes) {
+	uint64_t r = 0;
+	for (int i = 0; i < bytes; i++)
+		r = (r << 8) | fuzz_byte(s);
+	return r;
+}
+
+/* Common settings are picked more often than the rest so that the fast
+ * paths, which only exist for them, get most of the attention. */
+static void fuzz_configure(fuzz_config_t *c, fuzz_source_t *s) {
+	static const int bases[] = { 16, 16, 16, 8, 10, 2, };
+	memset(c, 0, sizeof (*c));
+	hexy_t *h = &c->h;
+	const unsigned b = fuzz_byte(s), a = fuzz_byte(s), g = fuzz_byte(s), n = fuzz_byte(s);
+	h->base = b < 192 ? bases[b % HEXY_NELEMS(bases)] : 2 + (int)(b % 35);
+	h->abase = a < 128 ? 0 : 2 + (int)(a % 35);
+	h->group = g < 128 ? 1 << (g % 5) : 1 + (int)(g % HEXY_MAX_GROUP);
+	h->ncols = n < 128 ? HEXY_MAX(16 / h->group, 1) : 1 + (int)(n % HEXY_MAX_NCOLS);
+	h->base  = b < 252 ? h->base  : b & 1 ? 1 : 37; /* and a few that are out of range */
+	h->group = g < 254 ? h->group : HEXY_MAX_GROUP + 1;
+	h->ncols = n < 254 ? h->ncols : HEXY_MAX_NCOLS + 1;
+	const unsigned f = fuzz_byte(s) | (fuzz_byte(s) << 8), format = (f >> 8) & 7;
+	h->chars_off     = f & 1;
+	h->addresses_off = f & 2;
+	h->newlines_off  = f & 4;
+	h->uppercase_on  = f & 8;
+	h->rev_grp_on    = f & 16;
+	h->squeeze_on    = f & 32;
+	h->words_on      = f & 64;
+	h->color_on      = f & 128;
+	h->format = format < HEXY_FORMAT_COUNT_E ? (int)format : HEXY_FORMAT_HEXDUMP_E;
+	h->awidth = (f >> 11) & 1 ? (int)(fuzz_byte(s) % 24) : 0;
+	c->defaults = !((f >> 12) & 1);
+	if (!c->defaults) {
+		char **seps[] = { &h->sep_adr, &h->sep_eol, &h->sep_byt, &h->sep_ch1, &h->sep_ch2, };
+		for (size_t i = 0; i < HEXY_NELEMS(seps); i++)
+			*seps[i] = (char*)fuzz_seps[fuzz_byte(s) % HEXY_NELEMS(fuzz_seps)];
+	}
+	h->address = (f >> 13) & 1 ? fuzz_number(s, 5) : 0;
+	h->offset = (f >> 14) & 1 ? fuzz_number(s, 2) : 0;
+	h->length = (f >> 15) & 1 ? 1 + fuzz_number(s, 2) : 0;
+	const unsigned t = fuzz_byte(s), k = fuzz_byte(s), w = fuzz_byte(s);
+	c->threads = 1 + (t % 4);
+	c->cached = t & 4;
+	c->chunk = k < 128 ? 1 + (k % 17) : 1 + (k * 31);
+	c->window = 1 + (w % 100);
+}
+
+/* Digits of the big endian number in the `length` bytes of `b` in `base`
+ * by long division, zero padded to `width`, returns the number written. */
+static size_t fuzz_digits(char *out, const uint8_t *b, size_t length, int base, size_t width, bool upper) {
+	const char *set = upper ? "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ" : "0123456789abcdefghijklmnopqrstuvwxyz";
+	uint8_t v[16] = { 0, };
+	char r[160];
+	size_t k = 0;
+	assert(length <= sizeof (v));
+	memcpy(v, b, length);
+	for (bool zero = false; !zero;) {
+		unsigned rem = 0;
+		zero = true;
+		for (size_t i = 0; i < length; i++) {
+			const unsigned cur = (rem * 256) + v[i];
+			v[i] = cur / base;
+			rem = cur % base;
+			zero = zero && !v[i];
+		}
+		r[k++] = set[rem];
+	}
+	while (k < width)
+		r[k++] = '0';
+	for (size_t i = 0; i < k; i++)
+		out[i] = r[k - i - 1];
+	return k;
+}
+
+static size_t fuzz_width(size_t length, int base) { /* digits in the largest number of `length` bytes */
+	const uint8_t ff[16] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, };
+	char d[160];
+	return fuzz_digits(d, ff, length, base, 0, false);
+}
+
+static size_t fuzz_cat(char *out, size_t used, const char *s, size_t length) {
+	memcpy(&out[used], s, length);
+	return used + length;
+}
+
+static size_t fuzz_pad(char *out, size_t used, long n) {
+	for (; n > 0; n--)
+		out[used++] = ' ';
+	return used;
+}
+
+/* A row of a hex-dump, worked out from the configuration alone; only the
+ * unescaped separators are taken from the library (`h` has been checked). */
+static size_t fuzz_reference_row(const hexy_t *h, char *out, size_t used, const uint8_t *row, size_t length, uint64_t address) {
+	uint8_t b[HEXY_MAX_NCOLS * HEXY_MAX_GROUP];
+	const size_t group = h->group, ncols = h->ncols, missing = (ncols * group) - length;
+	memcpy(b, row, length);
+	for (size_t i = 0; h->rev_grp_on && ((i + 1) * group) <= length; i++)
+		for (size_t j = 0; j < group / 2; j++) {
+			const uint8_t t = b[(i * group) + j];
+			b[(i * group) + j] = b[(i * group) + group - j - 1];
+			b[(i * group) + group - j - 1] = t;
+		}
+	if (!h->addresses_off) {
+		uint8_t a[8];
+		char d[80];
+		for (int i = 0; i < 8; i++)
+			a[i] = address >> (56 - (8 * i));
+		const long length = fuzz_digits(d, a, 8, h->abase, 0, h->uppercase_on), legacy = fuzz_width(2, h->abase);
+		used = fuzz_pad(out, used, h->awidth ? h->awidth - length : HEXY_MIN(legacy - length, 4));
+		used = fuzz_cat(out, used, d, length);
+		used = fuzz_cat(out, used, h->sep.adr.b, h->sep.adr.length);
+	}
+	const size_t width = fuzz_width(1, h->base);
+	long pad = width * missing;
+	if (h->words_on && h->base != 2 && h->base != 4 && h->base != 16) {
+		pad = ncols * fuzz_width(group, h->base);
+		for (size_t i = 0, idx = 0; i < ncols; i++) {
+			const size_t n = idx < length ? HEXY_MIN(group, length - idx) : 0;
+			if (n) {
+				const size_t w = fuzz_digits(&out[used], &b[idx], n, h->base, fuzz_width(n, h->base), h->uppercase_on);
+				used += w;
+				pad -= w;
+				idx += n;
+			}
+			used = fuzz_cat(out, used, h->sep.byt.b, h->sep.byt.length);
+		}
+	} else {
+		for (size_t i = 0, idx = 0; i < ncols; i++) {
+			for (size_t j = 0; j < group && idx < length; j++, idx++)
+				used += fuzz_digits(&out[used], &b[idx], 1, h->base, width, h->uppercase_on);
+			used = fuzz_cat(out, used, h->sep.byt.b, h->sep.byt.length);
+		}
+	}
+	if (!h->chars_off) {
+		used = fuzz_pad(out, used, pad);
+		used = fuzz_cat(out, used, h->sep.ch1.b, h->sep.ch1.length);
+		for (size_t i = 0; i < length; i++)
+			out[used++] = b[i] > 32 && b[i] < 127 ? (char)b[i] : HEXY_NON_GRAPHIC_REPLACEMENT_CHAR;
+		used = fuzz_pad(out, used, missing);
+		used = fuzz_cat(out, used, h->sep.ch2.b, h->sep.ch2.length);
+	}
+	if (!h->newlines_off || !h->chars_off || !h->addresses_off)
+		used = fuzz_cat(out, used, h->sep.eol.b, h->sep.eol.length);
+	return used;
+}
+
+/* The whole hex-dump, with skipping, limits and squeezing, colour is left out. */
+static size_t fuzz_reference(const hexy_t *h, const uint8_t *in, size_t length, bool squeeze, char *out) {
+	const size_t skip = HEXY_MIN((uint64_t)length, h->offset), row = h->ncols * h->group;
+	const uint8_t *prev = NULL;
+	bool squeezing = false;
+	in += skip;
+	length -= skip;
+	length = h->length ? HEXY_MIN((uint64_t)length, h->length) : length;
+	squeeze = squeeze && !h->addresses_off;
+	const bool newlines = !h->newlines_off || !h->chars_off || !h->addresses_off;
+	uint64_t address = h->address + h->offset;
+	size_t used = 0;
+	for (size_t at = 0; at < length; at += row, address += row) {
+		const size_t n = HEXY_MIN(row, length - at);
+		if (squeeze && n == row && prev && !memcmp(prev, &in[at], row)) {
+			if (!squeezing) {
+				out[used++] = '*';
+				used = fuzz_cat(out, used, h->sep.eol.b, h->sep.eol.length);
+			}
+			squeezing = true;
+			continue;
+		}
+		prev = n == row ? &in[at] : NULL;
+		squeezing = false;
+		used = fuzz_reference_row(h, out, used, &in[at], n, address);
+		if (n < row && newlines) /* a partial row ends the dump with an extra newline */
+			used = fuzz_cat(out, used, h->sep.eol.b, h->sep.eol.length);
+	}
+	if (squeezing) /* the last row of a run is printed so the length is known */
+		used = fuzz_reference_row(h, out, used, prev, row, address - row);
+	return used;
+}
+
+static size_t fuzz_uncolor(char *b, size_t length) {
+	size_t k = 0;
+	for (size_t i = 0; i < length; i++) {
+		if (b[i] == 27) {
+			while (i < length && b[i] != 'm')
+				i++;
+			continue;
+		}
+		b[k++] = b[i];
+	}
+	return k;
+}
+
+static int fuzz_dump(const fuzz_config_t *c, int engine, const uint8_t *in, size_t length, hexy_buffer_t *out) {
+	hexy_t h = c->h;
+	hexy_buffer_t bi = { .b = (uint8_t*)in, .length = length, };
+	hexy_io_t io = { .get = hexy_buffer_get, .put = hexy_buffer_put, .in = &bi, .out = out, };
+	out->used = 0;
+	h.io = io;
+	if (engine != FUZZ_BYTES_E) {
+		h.io.read_block = hexy_buffer_read;
+		h.io.write_block = hexy_buffer_write;
+		h.io.seek = hexy_buffer_seek;
+	}
+	switch (engine) {
+	case FUZZ_BYTES_E:
+	case FUZZ_BLOCKS_E:
+		return hexy(&h);
+	case FUZZ_GENERIC_E:
+		return hexy_dump(&h, true, true, h.format == HEXY_FORMAT_HEXDUMP_E ? hexy_render_row : NULL);
+	case FUZZ_PUSH_E:
+		if (hexy_begin(&h) < 0)
+			return HEXY_ELINE;
+		for (size_t i = 0, n = 0; i < length; i += n) {
+			n = HEXY_MIN(c->chunk, length - i);
+			if (hexy_feed(&h, &in[i], n) < 0)
+				return HEXY_ELINE;
+		}
+		return hexy_finish(&h);
+	case FUZZ_PARALLEL_E:
+#ifdef HEXY_THREADS
+		return hexy_parallel(&h, in, length, c->threads);
+#else
+		return hexy(&h);
+#endif
+	case FUZZ_ROWS_E: {
+		hexy_cache_t cache = { .blocks = NULL, };
+		h.squeeze_on = false;
+		h.io.seek_to = hexy_buffer_seek_to;
+		if (c->cached && hexy_cache_open(&cache, &h, 2) < 0)
+			return HEXY_ELINE;
+		int r = 0;
+		for (uint64_t at = 0; r >= 0; at += c->window) {
+			r = hexy_rows(&h, c->cached ? &cache : NULL, at, at + c->window);
+			if (r >= 0 && (uint64_t)r < c->window)
+				break;
+		}
+		if (c->cached)
+			hexy_cache_close(&cache, &h);
+		return r < 0 ? HEXY_ELINE : 0;
+	}
+	}
+	return HEXY_ELINE;
+}
+
+static int fuzz_fail(const fuzz_config_t *c, const char *what, const char *expected, size_t elength, const char *got, size_t glength) {
+	const hexy_t *h = &c->h;
+	size_t at = 0;
+	while (at < elength && at < glength && expected[at] == got[at])
+		at++;
+	(void)fprintf(stderr, "fuzz: %s differs at byte %lu (lengths %lu and %lu)\n", what, (unsigned long)at, (unsigned long)elength, (unsigned long)glength);
+	(void)fprintf(stderr, "fuzz: base %d abase %d group %d ncols %d format %d awidth %d address %llu offset %llu length %llu\n",
+		h->base, h->abase, h->group, h->ncols, h->format, h->awidth,
+		(unsigned long long)h->address, (unsigned long long)h->offset, (unsigned long long)h->length);
+	(void)fprintf(stderr, "fuzz: chars-off %d address-off %d newlines-off %d upper %d reverse %d squeeze %d words %d color %d defaults %d\n",
+		h->chars_off, h->addresses_off, h->newlines_off, h->uppercase_on, h->rev_grp_on, h->squeeze_on, h->words_on, h->color_on, c->defaults);
+	if (expected && got) {
+		const size_t from = at > 40 ? at - 40 : 0;
+		(void)fprintf(stderr, "fuzz: expected \"%.*s\"\nfuzz: got      \"%.*s\"\n",
+			(int)HEXY_MIN(elength - from, 80), &expected[from], (int)HEXY_MIN(glength - from, 80), &got[from]);
+	}
+	return -1;
+}
+
+static int fuzz_kernels(const uint8_t *in, size_t length, char *o1, char *o2) {
+	for (int upper = 0; upper < 2; upper++) {
+		const size_t off = length & 15 ? 1 : 0; /* and an unaligned start */
+		hexy_hex_encode(&in[off], length - off, o1, upper);
+		hexy_hex_encode_scalar(&in[off], length - off, o2, upper);
+		if (memcmp(o1, o2, (length - off) * 2))
+			return -1;
+	}
+	hexy_render_chars(in, length, o1);
+	for (size_t i = 0; i < length; i++)
+		if (o1[i] != (in[i] > 32 && in[i] < 127 ? (char)in[i] : HEXY_NON_GRAPHIC_REPLACEMENT_CHAR))
+			return -1;
+	for (size_t i = 0; (i + 8) <= length && i < 256; i += 8) {
+		uint64_t n = 0;
+		memcpy(&n, &in[i], 8);
+		for (unsigned base = 2; base <= 36; base++) {
+			hexy_divider_t d;
+			hexy_divider_make(&d, base);
+			uint64_t m = n;
+			const unsigned rem = hexy_divmod(&d, &m);
+			if (hexy_div(&d, n) != n / base || m != n / base || rem != n % base)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/* Strings made from the data must not upset the parsers, whatever they are. */
+static int fuzz_strings(const uint8_t *in, size_t length) {
+	char s[256], t[256];
+	const size_t n = HEXY_MIN(length, sizeof (s) - 1);
+	memcpy(s, in, n);
+	s[n] = '\0';
+	memcpy(t, s, n + 1);
+	const size_t l = strlen(s);
+	const int r = hexy_unescape(t, l + 1);
+	if (r >= 0 && ((size_t)r > l || t[r] != '\0'))
+		return -1;
+	if (!strchr(s, '\\') && (r != (int)l || strcmp(s, t)))
+		return -1;
+
+	char *argv[18] = { (char*)"fuzz", };
+	int argc = 1;
+	for (size_t i = 0; i < n && argc < (int)HEXY_NELEMS(argv) - 1; i += strlen(&s[i]) + 1) {
+		for (size_t j = i; j < n; j++)
+			s[j] = s[j] == ' ' ? '\0' : s[j];
+		argv[argc++] = &s[i];
+	}
+	argv[argc] = NULL;
+	hexy_getopt_t opt = { .error = NULL, };
+	int calls = 0;
+	for (int ch = 0; (ch = hexy_getopt(&opt, argc, argv, "hb#B#n#g#j#S#l#s:o:p:P:dfrRtuvw")) != -1; calls++) {
+		if (calls > (int)(n + 2) || opt.index < 1 || opt.index > argc)
+			return -1;
+		if ((ch == 's' || ch == 'o' || ch == 'p' || ch == 'P') && !opt.arg)
+			return -1;
+	}
+	return opt.index >= 1 && opt.index <= argc ? 0 : -1;
+}
+
+static int fuzz_one(const uint8_t *data, size_t size) {
+	fuzz_source_t s = { .b = data, .length = size, };
+	fuzz_config_t c;
+	fuzz_configure(&c, &s);
+	const uint8_t *in = &data[s.used];
+	const size_t length = size - s.used;
+	int r = -1;
+
+	hexy_t t = c.h; /* the configuration as the library sees it, or not at all */
+	const bool valid = hexy_config_default(&t) >= 0;
+	const size_t rows = (length / (t.ncols * t.group)) + 3;
+	const size_t size_out = valid ? (rows * (hexy_line_max(&t) + HEXY_MAX_SEP + 2)) + (2 * HEXY_LINE_BUF_SIZE) : HEXY_LINE_BUF_SIZE;
+	char *b1 = (char*)malloc(size_out), *b2 = (char*)malloc(size_out), *b3 = (char*)malloc(size_out);
+	if (!b1 || !b2 || !b3) {
+		(void)fprintf(stderr, "fuzz: out of memory\n");
+		goto done;
+	}
+	hexy_buffer_t reference = { .b = (uint8_t*)b1, .length = size_out, }, out = { .b = (uint8_t*)b2, .length = size_out, };
+	const int expected = fuzz_dump(&c, FUZZ_BYTES_E, in, length, &reference);
+	if ((expected >= 0) != valid) {
+		r = fuzz_fail(&c, "validity", NULL, 0, NULL, 0);
+		goto done;
+	}
+	const bool hexdump = valid && t.format == HEXY_FORMAT_HEXDUMP_E;
+	for (int e = FUZZ_BLOCKS_E; e < FUZZ_ENGINES_E; e++) {
+		if (e == FUZZ_ROWS_E && !hexdump)
+			continue;
+		const int got = fuzz_dump(&c, e, in, length, &out);
+		if ((got >= 0) != (expected >= 0)) {
+			r = fuzz_fail(&c, fuzz_engines[e], b1, reference.used, b2, out.used);
+			goto done;
+		}
+		if (expected < 0)
+			continue;
+		size_t want = reference.used;
+		const char *against = b1;
+		if (e == FUZZ_ROWS_E && t.squeeze_on) { /* windows are never squeezed */
+			fuzz_config_t plain = c;
+			plain.h.squeeze_on = false;
+			hexy_buffer_t o3 = { .b = (uint8_t*)b3, .length = size_out, };
+			if (fuzz_dump(&plain, FUZZ_BYTES_E, in, length, &o3) < 0) {
+				r = fuzz_fail(&c, "unsqueezed", NULL, 0, NULL, 0);
+				goto done;
+			}
+			want = o3.used;
+			against = b3;
+		}
+		if (out.used != want || memcmp(against, b2, want)) {
+			r = fuzz_fail(&c, fuzz_engines[e], against, want, b2, out.used);
+			goto done;
+		}
+	}
+	if (hexdump) {
+		const size_t l = fuzz_reference(&t, in, length, t.squeeze_on, b3);
+		memcpy(b2, b1, reference.used);
+		const size_t u = t.color_on ? fuzz_uncolor(b2, reference.used) : reference.used;
+		if (l != u || memcmp(b3, b2, l)) {
+			r = fuzz_fail(&c, "reference", b3, l, b2, u);
+			goto done;
+		}
+	}
+	if (hexdump && c.defaults && !t.color_on && !t.words_on && !t.address && !t.offset) {
+		hexy_buffer_t dump = { .b = (uint8_t*)b1, .length = reference.used, }, undumped = { .b = (uint8_t*)b2, .length = size_out, };
+		hexy_t u = c.h;
+		u.io = (hexy_io_t){ .get = hexy_buffer_get, .put = hexy_buffer_put, .in = &dump, .out = &undumped, };
+		const size_t want = t.length ? HEXY_MIN((uint64_t)length, t.length) : length;
+		if (hexy_undump(&u) < 0 || undumped.used != want || memcmp(in, b2, want)) {
+			r = fuzz_fail(&c, "undump", (const char*)in, want, b2, undumped.used);
+			goto done;
+		}
+	}
+	if (fuzz_kernels(in, HEXY_MIN(length, size_out / 2), b1, b2) < 0) {
+		r = fuzz_fail(&c, "kernels", NULL, 0, NULL, 0);
+		goto done;
+	}
+	if (fuzz_strings(in, length) < 0) {
+		r = fuzz_fail(&c, "strings", NULL, 0, NULL, 0);
+		goto done;
+	}
+	r = 0;
+done:
+	free(b1);
+	free(b2);
+	free(b3);
+	return r;
+}
+
+#ifdef FUZZ_LIBFUZZER
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	if (fuzz_one(data, size) < 0)
+		abort();
+	return 0;
+}
+#else
+typedef struct {
+	const char *name; /* no spaces, it is used as a key in the throughput file */
+	int base, group, format;
+	bool chars_off, raw, words, color, squeeze;
+} fuzz_perf_t;
+
+static const fuzz_perf_t fuzz_perfs[] = {
+	{ .name = "base16",     .base = 16, .group = 1, },
+	{ .name = "base10",     .base = 10, .group = 1, },
+	{ .name = "base8",      .base =  8, .group = 1, },
+	{ .name = "base2",      .base =  2, .group = 1, },
+	{ .name = "group4",     .base = 16, .group = 4, },
+	{ .name = "group3",     .base = 16, .group = 3, },
+	{ .name = "words10",    .base = 10, .group = 8, .words = true, },
+	{ .name = "chars-off",  .base = 16, .group = 1, .chars_off = true, },
+	{ .name = "raw",        .base = 16, .group = 1, .raw = true, },
+	{ .name = "color",      .base = 16, .group = 1, .color = true, },
+	{ .name = "squeeze",    .base = 16, .group = 1, .squeeze = true, },
+	{ .name = "format-c",   .base = 16, .group = 1, .format = HEXY_FORMAT_C_E, },
+	{ .name = "format-od",  .base = 16, .group = 1, .format = HEXY_FORMAT_OD_E, },
+};
+
+static double fuzz_now(void) {
+#if defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+#endif
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static int fuzz_sink(void *out, const char *buf, size_t length) {
+	(void)buf;
+	*(uint64_t*)out += length;
+	return length;
+}
+
+static int fuzz_sink_put(void *out, int ch) {
+	*(uint64_t*)out += 1;
+	return ch;
+}
+
+static uint32_t fuzz_random(uint32_t *x) { /* xorshift32 */
+	*x ^= *x << 13;
+	*x ^= *x >> 17;
+	*x ^= *x << 5;
+	return *x;
+}
+
+/* MB/s of the best of `FUZZ_PERF_RUNS` dumps of `data`, negative on error */
+static double fuzz_throughput(const fuzz_perf_t *p, uint8_t *data, size_t size) {
+	double best = 0;
+	for (int i = 0; i < FUZZ_PERF_RUNS; i++) {
+		uint64_t wrote = 0;
+		hexy_buffer_t in = { .b = data, .length = size, };
+		hexy_t h = {
+			.io = { .get = hexy_buffer_get, .put = fuzz_sink_put, .in = &in, .out = &wrote, .read_block = hexy_buffer_read, .write_block = fuzz_sink, },
+			.chars_off = p->chars_off || p->raw, .addresses_off = p->raw, .newlines_off = p->raw,
+			.squeeze_on = p->squeeze, .words_on = p->words, .color_on = p->color,
+			.base = p->base, .group = p->group, .format = p->format,
+		};
+		const double start = fuzz_now();
+		if (hexy(&h) < 0)
+			return -1;
+		const double took = HEXY_MAX(fuzz_now() - start, 1e-9);
+		best = HEXY_MAX(best, (size / 1e6) / took);
+	}
+	return best;
+}
+
+/* Measure each of `fuzz_perfs` and compare them with `file`, which holds
+ * a name and MB/s on each line, or write them to it if it does not exist
+ * (or `record` is set). Slower than recorded by more than `tolerance`
+ * percent is a failure. */
+static int fuzz_perf(const char *file, bool record, long tolerance) {
+	double recorded[HEXY_NELEMS(fuzz_perfs)] = { 0, };
+	FILE *f = record ? NULL : fopen(file, "rb");
+	if (f) {
+		char name[64];
+		double mbs = 0;
+		while (fscanf(f, "%63s %lf", name, &mbs) == 2)
+			for (size_t i = 0; i < HEXY_NELEMS(fuzz_perfs); i++)
+				if (!strcmp(name, fuzz_perfs[i].name))
+					recorded[i] = mbs;
+		(void)fclose(f);
+	}
+	const bool compare = f != NULL;
+	uint8_t *data = (uint8_t*)malloc(FUZZ_PERF_SIZE);
+	if (!data)
+		return -1;
+	uint32_t x = 2463534242u; /* mostly random with some text and runs, as in `bench.c` */
+	for (size_t i = 0; i < FUZZ_PERF_SIZE; i++) {
+		const uint32_t v = fuzz_random(&x);
+		data[i] = (i / 64) % 3 == 0 ? (v & 0xff) : (i / 64) % 3 == 1 ? ' ' + (v % 95) : 0;
+	}
+	int r = 0;
+	double measured[HEXY_NELEMS(fuzz_perfs)] = { 0, };
+	for (size_t i = 0; i < HEXY_NELEMS(fuzz_perfs); i++) {
+		measured[i] = fuzz_throughput(&fuzz_perfs[i], data, FUZZ_PERF_SIZE);
+		const bool slow = compare && recorded[i] > 0 && measured[i] < (recorded[i] * (100 - tolerance) / 100.0);
+		(void)printf("%-12s %10.1f MB/s", fuzz_perfs[i].name, measured[i]);
+		if (compare && recorded[i] > 0)
+			(void)printf(" (recorded %.1f, %+.1f%%)%s", recorded[i], ((measured[i] / recorded[i]) - 1) * 100.0, slow ? " SLOWER" : "");
+		(void)printf("\n");
+		if (measured[i] < 0 || slow)
+			r = -1;
+	}
+	free(data);
+	if (!compare) {
+		if (!(f = fopen(file, "wb")))
+			return -1;
+		for (size_t i = 0; i < HEXY_NELEMS(fuzz_perfs); i++)
+			if (fprintf(f, "%s %.1f\n", fuzz_perfs[i].name, measured[i]) < 0)
+				r = -1;
+		if (fclose(f) < 0)
+			r = -1;
+		(void)printf("recorded in %s\n", file);
+	}
+	return r;
+}
+
+static int fuzz_file(const char *name) {
+	FILE *f = fopen(name, "rb");
+	if (!f) {
+		(void)fprintf(stderr, "cannot open %s\n", name);
+		return -1;
+	}
+	uint8_t *b = NULL;
+	size_t used = 0, size = 0;
+	bool error = false;
+	for (size_t got = 1; got;) {
+		if (used == size) {
+			uint8_t *n = (uint8_t*)realloc(b, size = (size * 2) + 4096);
+			if (!n) {
+				error = true;
+				break;
+			}
+			b = n;
+		}
+		got = fread(&b[used], 1, size - used, f);
+		used += got;
+	}
+	error = error || ferror(f);
+	(void)fclose(f);
+	const int r = error || !b ? -1 : fuzz_one(b, used);
+	free(b);
+	if (r < 0)
+		(void)fprintf(stderr, "fuzz: %s failed\n", name);
+	return r;
+}
+
+static int fuzz_save(const uint8_t *b, size_t length) {
+	FILE *f = fopen(FUZZ_FAILURE, "wb");
+	const bool ok = f && fwrite(b, 1, length, f) == length;
+	if (f && fclose(f) < 0)
+		return -1;
+	return ok ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+	long runs = 1000, seed = 1, max = FUZZ_MAX_INPUT, tolerance = FUZZ_PERF_TOLERANCE;
+	const char *perf = NULL;
+	bool record = false;
+	hexy_getopt_t opt = { .error = stderr, };
+	for (int ch = 0; (ch = hexy_getopt(&opt, argc, argv, "hn#s#m#p:rT#")) != -1;) {
+		switch (ch) {
+		case 'n': runs = opt.narg; break;
+		case 's': seed = opt.narg; break;
+		case 'm': max = opt.narg; break;
+		case 'p': perf = opt.arg; break;
+		case 'r': record = true; break;
+		case 'T': tolerance = opt.narg; break;
+		default:
+			(void)fprintf(stderr, "usage: %s [-n runs] [-s seed] [-m max-input] [-p throughput-file [-r] [-T percent, default %d]] [files...]\n", argv[0], FUZZ_PERF_TOLERANCE);
+			return ch != 'h';
+		}
+	}
+	if (runs < 0 || max < 1 || tolerance < 0 || tolerance > 100)
+		return 1;
+	for (int i = opt.index; i < argc; i++)
+		if (fuzz_file(argv[i]) < 0)
+			return 1;
+	if (opt.index < argc) /* files were given, only they are run */
+		return 0;
+	const size_t size = 64 + max;
+	uint8_t *b = (uint8_t*)malloc(size);
+	if (!b)
+		return 1;
+	uint32_t x = ((uint32_t)seed * 2654435761u) | 1u;
+	for (long i = 0; i < runs; i++) {
+		const size_t config = 32, lengths[] = { 0, 16, 256, (size_t)max, };
+		const size_t length = HEXY_MIN(config + (fuzz_random(&x) % (lengths[fuzz_random(&x) % 4] + 1)), size);
+		for (size_t j = 0; j < length;) { /* random bytes, text and runs, so squeezing and the character view get used */
+			const uint32_t v = fuzz_random(&x), n = HEXY_MIN(1 + (v >> 24) % 64, length - j), kind = j < config ? 0 : v % 3;
+			for (size_t k = 0; k < n; k++, j++)
+				b[j] = kind == 0 ? fuzz_random(&x) & 0xff : kind == 1 ? ' ' + (fuzz_random(&x) % 95) : (v >> 8) & 0xff;
+		}
+		if (fuzz_one(b, length) < 0) {
+			(void)fprintf(stderr, "fuzz: run %ld of seed %ld failed, %s\n", i, seed, fuzz_save(b, length) < 0 ? "could not save it" : "saved in " FUZZ_FAILURE);
+			free(b);
+			return 1;
+		}
+	}
+	free(b);
+	(void)printf("%ld runs of seed %ld passed\n", runs, seed);
+	if (perf && fuzz_perf(perf, record, tolerance) < 0) {
+		(void)fprintf(stderr, "fuzz: throughput check failed\n");
+		return 1;
+	}
+	return 0;
+}
+#endif
@@ -1,6 +1,10 @@
 #ifndef HEXY_H
 #define HEXY_H
 
+#if defined(HEXY_DEFINE_MAIN) && defined(__linux__) && !defined(_POSIX_C_SOURCE) && !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* the utility uses POSIX (`mmap`, `fileno`, ...) when targeting it */
+#endif
+
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
@@ -10,6 +14,45 @@
 #include <string.h>
 #include <stdlib.h>
 
+#ifndef HEXY_NO_SIMD /* define to use only the portable scalar routines */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HEXY_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HEXY_SIMD_NEON
+#endif
+#endif
+
+#if defined(HEXY_DEFINE_MAIN) && !defined(HEXY_NO_THREADS) && (defined(__unix__) || defined(__APPLE__))
+#define HEXY_THREADS
+#endif
+
+#ifdef HEXY_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef HEXY_NO_HEAP /* from here on any use of the system allocator is an error */
+#ifndef HEXY_NO_DIGIT_TABLE
+#define HEXY_NO_DIGIT_TABLE /* small builds keep `hexy_t` small as well */
+#endif
+#ifdef HEXY_DEFINE_MAIN
+#error "HEXY_NO_HEAP cannot be used with HEXY_DEFINE_MAIN, the utility allocates its buffers"
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC poison malloc calloc realloc free aligned_alloc posix_memalign
+#else
+#define malloc  hexy_no_heap_malloc_is_not_allowed
+#define calloc  hexy_no_heap_calloc_is_not_allowed
+#define realloc hexy_no_heap_realloc_is_not_allowed
+#define free    hexy_no_heap_free_is_not_allowed
+#endif
+#endif
+
+#if defined(HEXY_DEFINE_MAIN) && !defined(HEXY_NO_STATS) && !defined(HEXY_STATS)
+#define HEXY_STATS
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -50,6 +93,27 @@ extern "C" {
  * - `HEXY_UNIT_TESTS`: If defined then the unit tests are compiled
  *   in, otherwise the unit test function will be part of the API, it
  *   will just always return success.
+ * - `HEXY_NO_SIMD`: If defined then SSE2 (x86-64) or NEON (ARM) versions
+ *   of some routines are not used even if the compiler targets them.
+ * - `HEXY_THREADS`: If defined then `hexy_parallel`, which uses POSIX
+ *   threads, is available. This is defined along with `HEXY_DEFINE_MAIN`
+ *   on Unix like systems unless `HEXY_NO_THREADS` is defined.
+ * - `HEXY_STATS`: If defined then `hexy_io_t` contains a `stats` member
+ *   that counts rows, bytes and callback invocations and can time the I/O
+ *   callbacks and formatting. This changes the size of `hexy_t`, so it must
+ *   be the same everywhere the header is used. It is defined along with
+ *   `HEXY_DEFINE_MAIN` unless `HEXY_NO_STATS` is defined.
+ * - `HEXY_NO_HEAP`: If defined then any use of `malloc` and friends after
+ *   the header is included is a compile time error (with GCC and Clang,
+ *   elsewhere they are defined to undeclared names) and the library itself
+ *   only uses memory the caller gives it in `hexy_t.arena`, anything that
+ *   needs more than that degrades (to a single thread in `hexy_parallel`)
+ *   or fails. It cannot be used with `HEXY_DEFINE_MAIN`. It implies
+ *   `HEXY_NO_DIGIT_TABLE`.
+ * - `HEXY_NO_DIGIT_TABLE`: If defined then `hexy_t` does not hold a 2 KiB
+ *   table of the digits of each byte, in bases other than 16 they are made
+ *   with a multiply and shifts per digit instead, which is slower. This
+ *   changes the size of `hexy_t`, like `HEXY_STATS`.
  *
  * There are other macros defined however they are used for options to
  * control the behavior of the library and are not used to control how
@@ -108,9 +172,9 @@ extern "C" {
  * debugging purposes. "main()" will not be defined.
  *
  *
- * TODO: signed printing, unit tests, colors, undump, 
+ * TODO: signed printing, unit tests,
  * optional FILE* support, escape character support,
- * C++ integration, overflow checks, BUILD_BUG_ON,
+ * overflow checks, BUILD_BUG_ON,
  * more assertions, help section and explain this
  * library, ...
  */
@@ -127,6 +191,14 @@ extern "C" {
 #define HEXY_INTERNAL static inline
 #endif
 
+#ifndef HEXY_FORCE_INLINE
+#if defined(__GNUC__) || defined(__clang__)
+#define HEXY_FORCE_INLINE static inline __attribute__((always_inline))
+#else
+#define HEXY_FORCE_INLINE HEXY_INTERNAL
+#endif
+#endif
+
 #ifdef HEXY_DEFINE_MAIN
 #define HEXY_UNIT_TESTS
 #endif
@@ -148,7 +220,78 @@ extern "C" {
 #endif
 
 #ifndef HEXY_MAX_GROUP
-#define HEXY_MAX_GROUP (8)
+#ifdef HEXY_DEFINE_MAIN
+#define HEXY_MAX_GROUP (16) /* 128-bit words for the utility, `buf` and `prev` in `hexy_t` grow with this */
+#else
+#define HEXY_MAX_GROUP (8)  /* define as 16 for 128-bit words */
+#endif
+#endif
+
+#ifndef HEXY_ARENA_ALIGN
+#define HEXY_ARENA_ALIGN (16) /* alignment of memory handed out from `hexy_t.arena`, a power of two */
+#endif
+
+#ifndef HEXY_CHUNK_ROWS
+#define HEXY_CHUNK_ROWS (4096) /* number of rows `hexy_parallel` gives to a thread at a time */
+#endif
+
+#ifndef HEXY_DIFF_BLOCK
+#define HEXY_DIFF_BLOCK (16384) /* bytes of each input `hexy_diff` compares at a time, from `hexy_alloc` */
+#endif
+
+#ifndef HEXY_MAX_CONTEXT
+#define HEXY_MAX_CONTEXT (16) /* maximum rows of context `hexy_diff` and `hexy_search` print around rows */
+#endif
+
+#ifndef HEXY_CACHE_ROWS
+#define HEXY_CACHE_ROWS (64) /* rows rendered and kept together by a `hexy_cache_t` */
+#endif
+
+#ifndef HEXY_MAX_PATTERN
+#define HEXY_MAX_PATTERN (256) /* maximum length of a `hexy_pattern_t` */
+#endif
+
+#ifndef HEXY_SEARCH_BLOCK
+#define HEXY_SEARCH_BLOCK (32768) /* bytes of input `hexy_search` holds at a time, from `hexy_alloc` */
+#endif
+
+#ifndef HEXY_MAX_SEP
+#define HEXY_MAX_SEP (32) /* maximum length of each of the `sep_*` strings */
+#endif
+
+#ifndef HEXY_MAX_NAME
+#define HEXY_MAX_NAME (64) /* maximum length of the array name used by `HEXY_FORMAT_C_E` */
+#endif
+
+#define HEXY_COLOR_LENGTH (5) /* length of each colour escape sequence, "\x1b[36m" */
+#define HEXY_COLOR_RESET "\x1b[0m"
+
+#ifndef HEXY_LINE_STACK
+#define HEXY_LINE_STACK (1024) /* rows up to this long are rendered on the stack, longer ones in memory from `hexy_alloc` */
+#endif
+
+/* The longest row any configuration can produce, the worst case being base
+ * 2 using all columns with maximum length separators. Rows are rendered into
+ * a buffer sized for the longest row of the configuration in use instead
+ * (see `hexy_line_max`), which is on the stack if it fits in
+ * `HEXY_LINE_STACK` bytes. */
+#define HEXY_LINE_BUF_SIZE (\
+	(HEXY_PNUM_BUF_SIZE * 2)                          /* address and its alignment */\
+	+ (HEXY_MAX_NCOLS * HEXY_MAX_GROUP * 8 * 2)       /* base 2 digits and padding for missing bytes */\
+	+ (HEXY_MAX_NCOLS * HEXY_MAX_GROUP * 2)           /* character view and its padding */\
+	+ (((HEXY_MAX_NCOLS * HEXY_MAX_GROUP) + 1) * 2 * HEXY_COLOR_LENGTH) /* colour escapes, at most one per byte and a reset in each view */\
+	+ ((HEXY_MAX_NCOLS + 4) * HEXY_MAX_SEP))          /* a separator per column and the rest */
+
+/* Number of digits needed to print the byte 255 in base `B`, this is
+ * `hexy_unsigned_integer_logarithm(255, B)` as a constant expression. */
+#define HEXY_BYTE_WIDTH(B) ((B) >= 16 ? 2 : (B) >= 7 ? 3 : (B) >= 4 ? 4 : (B) == 3 ? 6 : 8)
+
+#ifdef HEXY_STATS
+#define HEXY_STAT(IO, FIELD, N) ((IO)->stats.FIELD += (N))
+#define HEXY_CLOCK(IO) ((IO)->stats.clock ? (IO)->stats.clock() : 0)
+#else
+#define HEXY_STAT(IO, FIELD, N) ((void)(IO), (void)(N))
+#define HEXY_CLOCK(IO) ((void)(IO), (uint64_t)0)
 #endif
 
 #define HEXY_MIN(X, Y) ((X) < (Y) ? (X) : (Y))
@@ -176,6 +319,25 @@ typedef struct {
 
 typedef int (*hexy_get_fn)(void *in);          /* callback for retrieving a byte, similar to `fgetc`. */
 typedef int (*hexy_put_fn)(void *out, int ch); /* callback for outputting a byte, similar to `fputc`. */
+typedef int (*hexy_read_fn)(void *in, uint8_t *buf, size_t length);         /* callback for retrieving a block, similar to `fread` */
+typedef int (*hexy_write_fn)(void *out, const char *buf, size_t length);    /* callback for outputting a block, similar to `fwrite` */
+typedef int (*hexy_seek_fn)(void *in, uint64_t offset);                     /* callback for skipping input, similar to `fseek` with `SEEK_CUR` */
+typedef int (*hexy_seek_to_fn)(void *in, uint64_t position);                /* callback for moving to a position, similar to `fseek` with `SEEK_SET` */
+
+#ifdef HEXY_STATS
+typedef uint64_t (*hexy_clock_fn)(void); /* returns the current time in any unit, used for `hexy_stats_t` */
+
+typedef struct {
+	uint64_t rows,                 /* rows formatted and output */
+	         squeezed,             /* rows not output as they repeated the previous one */
+	         bytes,                /* bytes of input formatted */
+	         reads,                /* calls to `get`, `read_block` and `seek` */
+	         writes,               /* calls to `put` and `write_block` */
+	         io_time,              /* time spent reading and writing, in `clock` units */
+	         format_time;          /* time spent formatting rows, in `clock` units */
+	hexy_clock_fn clock;           /* optional, times are only measured if set */
+} hexy_stats_t; /* instrumentation, where the time goes can be found by setting `clock` */
+#endif
 
 typedef struct {
 	hexy_get_fn get;               /* return negative on error, a byte (0-255) otherwise */
@@ -183,38 +345,145 @@ typedef struct {
 	void *in, *out;                /* passed to 'get' and 'put' respectively */
 	size_t read, wrote;            /* read only, bytes 'get' and 'put' respectively */
 	int error;                     /* an error has occurred */
+	hexy_read_fn read_block;       /* optional, used instead of `get`: return bytes read, 0 on EOF, negative on error */
+	hexy_write_fn write_block;     /* optional, used instead of `put`: return bytes written, negative on error */
+	hexy_seek_fn seek;             /* optional, skip input: return negative if not possible, input is read instead */
+	hexy_seek_to_fn seek_to;       /* optional, move to a position in the input: needed by `hexy_rows` */
+#ifdef HEXY_STATS
+	hexy_stats_t stats;            /* counters, only the `clock` member needs setting */
+#endif
 } hexy_io_t; /* I/O abstraction, use to redirect to wherever you want... */
 
+typedef struct {
+	size_t length;               /* length of `b`, which may contain NUL characters */
+	char b[HEXY_MAX_SEP + 1];    /* separator, NUL terminated */
+	const char *from;            /* the `sep_*` string `b` was made from, NULL if not made */
+} hexy_sep_t; /* separator after unescaping */
+
+typedef struct {
+	uint64_t magic;              /* reciprocal of `base` (its low 64 bits if `add`), unused for powers of two */
+	unsigned base,               /* divisor, zero if not made */
+	         shift;              /* shift applied to the high half of the product, or to the input for powers of two */
+	bool pow2,                   /* `base` is a power of two, shifts and masks are used */
+	     add;                    /* `magic` needs 65 bits, the input is added back in */
+} hexy_divider_t; /* division by a base with a multiply and shifts, for machines where division is slow */
+
+typedef struct {
+	uint64_t at;                 /* address `s` holds the digits of */
+	char s[64];                  /* digits of `at`, right aligned, enough for any `uint64_t` in base 2 */
+	uint8_t v[64];               /* value of each digit in `s` */
+	int length,                  /* number of digits in `s` */
+	    base,                    /* base of the digits, zero if not made */
+	    legacy;                  /* number of digits in 65535 in `base`, used for the default width */
+	bool upper;                  /* digits are upper case */
+	hexy_divider_t div;          /* divides by `base` */
+} hexy_counter_t; /* address as digits, only the digits that change are updated when it is incremented */
+
 typedef struct {
 	hexy_io_t io;                /* Hexdump I/O abstraction layer */
+	hexy_buffer_t arena;         /* Memory owned by the caller, used before the heap by anything that needs more than the stack */
 	uint64_t address;            /* Address to print if enabled, auto-incremented */
+	uint64_t offset,             /* Skip this many bytes of input before dumping, `address` is advanced by it */
+	         length;             /* If non-zero, dump at most this many bytes of input */
+	uint64_t fed;                /* Internal: bytes given to `hexy_feed` since `hexy_begin` */
+	uint64_t origin;             /* Internal: address the current dump started at, for `HEXY_FORMAT_C_E` */
 	size_t buf_used;             /* Number of bytes in buf used */
 	uint8_t buf[HEXY_MAX_NCOLS * HEXY_MAX_GROUP]; /* Buffer used to store characters for `chars_on` / data */
+	uint8_t prev[HEXY_MAX_NCOLS * HEXY_MAX_GROUP]; /* Internal: previous row, used when squeezing */
+#ifndef HEXY_NO_DIGIT_TABLE
+	char digits[256][8];         /* Internal: zero padded digits of each byte in `digits_base` */
+#endif
+	int digits_base,             /* Internal: base the digits were made for, zero if not made */
+	    digits_width;            /* Internal: number of digits per byte in `digits_base` */
+	bool digits_upper;           /* Internal: the digits are upper case */
+	uint8_t word_width[HEXY_MAX_GROUP + 1]; /* Internal: digits in a word of N bytes in `digits_base` */
+	hexy_counter_t counter;      /* Internal: `address` as digits in `abase` */
+	hexy_divider_t bdiv, adiv;   /* Internal: divide by `base` and `abase` */
 
         /* Each line looks like this: "XXXX: XX XX XX XX |....|",
 	 * where "X" is a digit it is possible to change what is printed out at 
 	 * different points in the line. The macros "HEXY_SEP_*" contain the
-	 * default. Accepting a format string (which would replace these
-	 * `sep_*` values) and handling escape characters are two possible extensions. */
+	 * default. The strings may contain escape characters (see `hexy_unescape`),
+	 * they are not modified, an unescaped copy of each is made in `sep` when
+	 * the configuration is checked and one of the pointers has changed since
+	 * (so point them at new strings rather than editing them in place,
+	 * an edit made in place is not noticed). Accepting a format string (which would
+	 * replace these `sep_*` values) is a possible extension. */
 	char *sep_adr,               /* Separator for address and bytes */
 	     *sep_eol,               /* End of line separator, usually "\n" */
 	     *sep_byt,               /* Separator between each of the bytes */
 	     *sep_ch1,               /* Separator for area between end of bytes and start of character */
 	     *sep_ch2;               /* Separator for area between end of character printing and newline */
+	struct {
+		hexy_sep_t adr, eol, byt, ch1, ch2;
+	} sep;                       /* Internal: unescaped `sep_*` strings, made by `hexy_make_seps` */
+	char *name;                  /* Name of the array declared by `HEXY_FORMAT_C_E`, "data" if NULL */
 
 	bool init,                   /* Has this structure been initialized? */
+	     prev_on,                /* Internal: `prev` contains the previous row */
+	     squeezing,              /* Internal: rows are currently being squeezed */
 	     chars_off,              /* Turn off: character printing on, implies newlines are on */
 	     addresses_off,          /* Turn off: address printing, implies newlines are on */
 	     newlines_off,           /* Turn off: Print a new line, columnizing output */
 	     uppercase_on,           /* If true: use upper case hex digits */
-	     rev_grp_on;             /* If true; reverse the group before printing (effectively changing endianess) */
+	     rev_grp_on,             /* If true; reverse the group before printing (effectively changing endianess) */
+	     squeeze_on,             /* If true; print "*" instead of rows repeating the previous one (needs addresses) */
+	     words_on,               /* If true; print each group as a single number instead of byte by byte */
+	     color_on;               /* If true; colour bytes by class (see `hexy_class_table`) with ANSI escapes, hex-dumps only */
 
 	int base,                    /* Base to print, if 0 auto-select, otherwise valid bases are between 2 and 36 */
 	    abase,                   /* Base to print addresses in, if 0 used `base` */
 	    group,                   /* Group bytes together in groups of X */
-	    ncols;                   /* Number of columns to print, must not exceed HEXY_MAX_NCOLS, if 0 auto-select*/
+	    ncols,                   /* Number of columns to print, must not exceed HEXY_MAX_NCOLS, if 0 auto-select*/
+	    awidth,                  /* Minimum width of addresses, if 0 that of 65535 (see `hexy_address_width`) */
+	    format;                  /* Output format, one of the `HEXY_FORMAT_*_E` values, 0 for a hex-dump */
+
+	char *line;                  /* Internal: row buffer taken by `hexy_begin` for rows too long for the stack */
+	size_t line_mark;            /* Internal: `arena.used` before `line` was taken */
 } hexy_t; /* Hexdump structure, for all your hex-dumping needs */
 
+typedef struct {
+	uint8_t b[HEXY_MAX_PATTERN]; /* bytes to search for */
+	size_t length;               /* number of bytes in `b`, at least one */
+	uint16_t skip[256];          /* Internal: shift for each byte ending a window that does not match */
+} hexy_pattern_t; /* a byte string prepared for searching by `hexy_pattern_make` */
+
+typedef struct {
+	uint64_t block;              /* rows from `block * HEXY_CACHE_ROWS` are held */
+	uint64_t used;               /* when it was last used, the least recently used block is replaced */
+	size_t rows;                 /* rows held, fewer than `HEXY_CACHE_ROWS` at the end of the input, 0 if empty */
+	size_t ends[HEXY_CACHE_ROWS]; /* end of each row in `text` */
+	char *text;                  /* the rendered rows, `hexy_cache_t.size` bytes long */
+} hexy_cache_block_t;
+
+typedef struct {
+	hexy_cache_block_t *blocks;  /* `count` blocks of rendered rows, from `hexy_cache_open` */
+	size_t count,                /* number of `blocks` */
+	       size;                 /* bytes of `text` in each block */
+	uint64_t clock,              /* Internal: incremented on each use of a block */
+	         hits, misses;       /* blocks found in the cache and rendered */
+} hexy_cache_t; /* rendered rows kept by `hexy_rows` so rows near the last ones asked for are not rendered again */
+
+typedef int (*hexy_render_fn)(hexy_t *h, char *line); /* renders the row in `h->buf` into a line, returns its length */
+
+enum { /* flags describing the layout of a row, used to select a specialized renderer */
+	HEXY_ROW_CHARS_E     = 1 << 0, /* character view is on */
+	HEXY_ROW_ADDRESSES_E = 1 << 1, /* addresses are on */
+	HEXY_ROW_NEWLINES_E  = 1 << 2, /* rows end with `sep_eol` */
+	HEXY_ROW_REVERSE_E   = 1 << 3, /* groups are reversed before rendering */
+	HEXY_ROW_WORDS_E     = 1 << 4, /* groups are printed as numbers, in a base where that differs from bytes */
+	HEXY_ROW_COLOR_E     = 1 << 5, /* bytes are coloured by class, as are the characters */
+};
+
+enum { /* output formats, selected with `hexy_t.format` (see `hexy_format_by_name`) */
+	HEXY_FORMAT_HEXDUMP_E, /* the default, addresses, bytes and a character view as configured */
+	HEXY_FORMAT_C_E,       /* a C array initializer, like `xxd -i` */
+	HEXY_FORMAT_JSON_E,    /* a JSON object per row, with the address as a number */
+	HEXY_FORMAT_PLAIN_E,   /* the digits of each byte with nothing in between, like `xxd -p` */
+	HEXY_FORMAT_OD_E,      /* zero padded addresses and a final address line, like `od -t x1` */
+	HEXY_FORMAT_COUNT_E,   /* number of formats, not a format */
+};
+
 typedef struct {
 	char *arg;   /* parsed argument */
 	long narg;   /* converted argument for '#' */
@@ -235,8 +504,8 @@ enum { /* used with `hexy_options_t` structure */
 };
 
 typedef struct { /* Used for parsing key=value strings (strings must be modifiable and persistent) */
-	char *opt,  /* key; name of option */
-	     *help; /* help string for option */
+	const char *opt,  /* key; name of option */
+	           *help; /* help string for option */
 	union { /* pointers to values to set */
 		bool *b; 
 		long *n; 
@@ -260,11 +529,41 @@ HEXY_EXTERN int hexy_buffer_get(void *in);
 HEXY_EXTERN int hexy_buffer_put(void *out, const int ch);
 HEXY_EXTERN int hexy_file_get(void *in);
 HEXY_EXTERN int hexy_file_put(void *out, int ch);
+HEXY_EXTERN int hexy_buffer_read(void *in, uint8_t *buf, size_t length);
+HEXY_EXTERN int hexy_buffer_write(void *out, const char *buf, size_t length);
+HEXY_EXTERN int hexy_file_read(void *in, uint8_t *buf, size_t length);
+HEXY_EXTERN int hexy_file_write(void *out, const char *buf, size_t length);
+HEXY_EXTERN int hexy_buffer_seek(void *in, uint64_t offset);
+HEXY_EXTERN int hexy_file_seek(void *in, uint64_t offset);
+HEXY_EXTERN int hexy_buffer_seek_to(void *in, uint64_t position);
+HEXY_EXTERN int hexy_file_seek_to(void *in, uint64_t position);
 HEXY_EXTERN int hexy_get(hexy_io_t *io);
 HEXY_EXTERN int hexy_put(hexy_io_t *io, const int ch);
+HEXY_EXTERN int hexy_read(hexy_io_t *io, uint8_t *buf, size_t length);
+HEXY_EXTERN int hexy_write(hexy_io_t *io, const char *buf, size_t length);
 HEXY_EXTERN int hexy_puts(hexy_io_t *io, const char *s);
 HEXY_EXTERN int hexy_unsigned_integer_logarithm(hexy_unum_t n, hexy_unum_t base);
+HEXY_EXTERN void hexy_hex_encode(const uint8_t *in, size_t length, char *out, bool upper);
+HEXY_EXTERN void hexy_render_chars(const uint8_t *in, size_t length, char *out);
 HEXY_EXTERN int hexy(hexy_t *h);
+HEXY_EXTERN int hexy_address_width(hexy_t *h, uint64_t length);
+HEXY_EXTERN int hexy_format_by_name(const char *name);
+HEXY_EXTERN int hexy_begin(hexy_t *h);
+HEXY_EXTERN int hexy_feed(hexy_t *h, const uint8_t *data, size_t length);
+HEXY_EXTERN int hexy_finish(hexy_t *h);
+HEXY_EXTERN int hexy_rows(hexy_t *h, hexy_cache_t *c, uint64_t r0, uint64_t r1);
+HEXY_EXTERN int hexy_cache_open(hexy_cache_t *c, hexy_t *h, size_t blocks);
+HEXY_EXTERN void hexy_cache_clear(hexy_cache_t *c);
+HEXY_EXTERN void hexy_cache_close(hexy_cache_t *c, hexy_t *h);
+HEXY_EXTERN int hexy_diff(hexy_t *h, hexy_io_t *other, int context);
+HEXY_EXTERN int hexy_pattern_make(hexy_pattern_t *p, const uint8_t *b, size_t length);
+HEXY_EXTERN int hexy_pattern_hex(hexy_pattern_t *p, const char *hex);
+HEXY_EXTERN size_t hexy_pattern_find(const hexy_pattern_t *p, const uint8_t *in, size_t length);
+HEXY_EXTERN int hexy_search(hexy_t *h, const hexy_pattern_t *p, int context);
+HEXY_EXTERN int hexy_undump(hexy_t *h);
+#ifdef HEXY_THREADS
+HEXY_EXTERN int hexy_parallel(hexy_t *h, const uint8_t *data, size_t length, int threads);
+#endif
 HEXY_EXTERN int hexy_convert(const char *n, int base, long *out);
 HEXY_EXTERN int hexy_flag(const char *v);
 HEXY_EXTERN int hexy_unescape(char *r, size_t length);
@@ -294,6 +593,163 @@ HEXY_API void hexy_reverse(char * const r, const size_t length) {
 	}
 }
 
+HEXY_INTERNAL uint16_t hexy_bswap16(uint16_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_bswap16(x);
+#else
+	return (x >> 8) | (x << 8);
+#endif
+}
+
+HEXY_INTERNAL uint32_t hexy_bswap32(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_bswap32(x);
+#else
+	return ((uint32_t)hexy_bswap16(x) << 16) | hexy_bswap16(x >> 16);
+#endif
+}
+
+HEXY_INTERNAL uint64_t hexy_bswap64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_bswap64(x);
+#else
+	return ((uint64_t)hexy_bswap32(x) << 32) | hexy_bswap32(x >> 32);
+#endif
+}
+
+/* Reverse a group of bytes in place, the common word sizes are loaded as
+ * a single integer and byte swapped instead of being reversed a byte at
+ * a time with `hexy_reverse`. */
+HEXY_INTERNAL void hexy_reverse_group(uint8_t *b, int group) {
+	assert(b);
+	switch (group) {
+	case 1: break;
+	case 2: { uint16_t v; memcpy(&v, b, 2); v = hexy_bswap16(v); memcpy(b, &v, 2); break; }
+	case 4: { uint32_t v; memcpy(&v, b, 4); v = hexy_bswap32(v); memcpy(b, &v, 4); break; }
+	case 8: { uint64_t v; memcpy(&v, b, 8); v = hexy_bswap64(v); memcpy(b, &v, 8); break; }
+	case 16: {
+		uint64_t lo, hi;
+		memcpy(&lo, b, 8);
+		memcpy(&hi, &b[8], 8);
+		lo = hexy_bswap64(lo);
+		hi = hexy_bswap64(hi);
+		memcpy(b, &hi, 8);
+		memcpy(&b[8], &lo, 8);
+		break;
+	}
+	default: hexy_reverse((char*)b, group); break;
+	}
+}
+
+/* Load the first `length` bytes of `b` as a big endian number of up to
+ * 128 bits into `hi` and `lo`. */
+HEXY_INTERNAL void hexy_load_word(const uint8_t *b, int length, uint64_t *hi, uint64_t *lo) {
+	assert(b);
+	assert(hi);
+	assert(lo);
+	assert(length > 0 && length <= 16);
+	*hi = 0;
+	*lo = 0;
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	if (length == 8 || length == 16) {
+		uint64_t v;
+		memcpy(&v, b, 8);
+		*lo = hexy_bswap64(v);
+		if (length == 8)
+			return;
+		*hi = *lo;
+		memcpy(&v, &b[8], 8);
+		*lo = hexy_bswap64(v);
+		return;
+	}
+	if (length == 4) {
+		uint32_t v;
+		memcpy(&v, b, 4);
+		*lo = hexy_bswap32(v);
+		return;
+	}
+#endif
+	for (int i = 0; i < length; i++) {
+		*hi = (*hi << 8) | (*lo >> 56);
+		*lo = (*lo << 8) | b[i];
+	}
+}
+
+/* The high 64 bits of the 128-bit product of `a` and `b`. */
+HEXY_FORCE_INLINE uint64_t hexy_mulhi64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+	__extension__ typedef unsigned __int128 hexy_u128_t;
+	return (uint64_t)(((hexy_u128_t)a * b) >> 64);
+#else
+	const uint64_t al = a & 0xffffffffull, ah = a >> 32, bl = b & 0xffffffffull, bh = b >> 32;
+	const uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	const uint64_t mid = (ll >> 32) + (lh & 0xffffffffull) + (hl & 0xffffffffull);
+	return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+/* Make a divider for `base`, as in "Division by Invariant Integers using
+ * Multiplication" (Granlund and Montgomery). For a base that is not a power
+ * of two and 2^k below it, `magic` is ceil(2^(64 + k) / base) if that is
+ * exact for every 64-bit input, as it is for ten, and otherwise it needs
+ * a 65th bit which is made up for by adding the input back in. Making
+ * one divides, so callers that convert more than one number make it once
+ * and keep it (as `hexy_t` does in `bdiv` and `adiv`). */
+HEXY_INTERNAL void hexy_divider_make(hexy_divider_t *d, unsigned base) {
+	assert(d);
+	assert(base >= 2 && base <= 36);
+	memset(d, 0, sizeof (*d));
+	d->base = base;
+	while ((2u << d->shift) <= base)
+		d->shift++;
+	d->pow2 = (1u << d->shift) == base;
+	if (d->pow2)
+		return;
+	const uint64_t t1 = (1ull << d->shift) << 32, q1 = t1 / base; /* 2^(64 + k) / base, 32 bits at a time */
+	const uint64_t t0 = (t1 % base) << 32, q0 = t0 / base, r = t0 % base, q = (q1 << 32) | q0;
+	if ((base - r) <= (1ull << d->shift)) { /* the error of rounding up is small enough */
+		d->magic = q + 1;
+		return;
+	}
+	d->magic = (q * 2) + ((r * 2) >= base) + 1; /* floor(2^(65 + k) / base) - 2^64 + 1 */
+	d->shift++;
+	d->add = true;
+}
+
+static const hexy_divider_t hexy_divider_8  = { .magic = 0, .base = 8, .shift = 3, .pow2 = true, .add = false, };
+static const hexy_divider_t hexy_divider_10 = { .magic = 0xcccccccccccccccdull, .base = 10, .shift = 3, .pow2 = false, .add = false, };
+
+HEXY_FORCE_INLINE uint64_t hexy_div(const hexy_divider_t *d, uint64_t n) {
+	if (d->pow2)
+		return n >> d->shift;
+	const uint64_t t = hexy_mulhi64(d->magic, n);
+	return d->add ? (t + ((n - t) >> 1)) >> (d->shift - 1) : t >> d->shift;
+}
+
+/* Divide `*n` by the base of `d` in place, returning the remainder. */
+HEXY_FORCE_INLINE unsigned hexy_divmod(const hexy_divider_t *d, uint64_t *n) {
+	assert(n);
+	const uint64_t q = hexy_div(d, *n), r = d->pow2 ? *n & (d->base - 1) : *n - (q * d->base);
+	*n = q;
+	return r;
+}
+
+/* Divide the 128-bit number in `hi` and `lo` by the base of `d` in place,
+ * returning the remainder, the low half is divided 32 bits at a time so
+ * no wider type is needed. */
+HEXY_FORCE_INLINE unsigned hexy_divmod128(uint64_t *hi, uint64_t *lo, const hexy_divider_t *d) {
+	assert(hi);
+	assert(lo);
+	uint64_t r = hexy_divmod(d, hi);
+	uint64_t t = (r << 32) | (*lo >> 32);
+	r = hexy_divmod(d, &t);
+	const uint64_t q1 = t;
+	t = (r << 32) | (*lo & 0xffffffffull);
+	r = hexy_divmod(d, &t);
+	*lo = (q1 << 32) | t;
+	return r;
+}
+
 /* Nested functions, even without solving the upwards or downward
  * funarg problems and just banning references to variables in the
  * containing scope, would be useful for these small functions. */
@@ -325,24 +781,36 @@ HEXY_API int hexy_tolower(const int ch) {
 	return hexy_isupper(ch) ? ch ^ 0x20 : ch;
 }
 
-HEXY_API int hexy_unum_to_string(char buf[/*static HEXY_PNUM_BUF_SIZE*/], hexy_unum_t in, hexy_unum_t base, bool upper) {
+/* `hexy_unum_to_string` with a divider made by the caller. */
+HEXY_INTERNAL void hexy_unum_digits(char buf[/*static HEXY_PNUM_BUF_SIZE*/], hexy_unum_t in, const hexy_divider_t *d, bool upper) {
 	assert(buf);
+	assert(d);
 	size_t i = 0;
-	hexy_unum_t dv = in;
-	if (!hexy_is_valid_base(base))
-		return HEXY_ELINE;
+	uint64_t dv = in;
 	do {
 		static const char *hexy_string_digits = "0123456789abcdefghijklmnopqrstuvwxyz";
-		const int ch = hexy_string_digits[dv % base];
+		const int ch = hexy_string_digits[hexy_divmod(d, &dv)];
 		buf[i++] = upper ? hexy_toupper(ch) : ch;
-	} while ((dv /= base));
+	} while (dv);
 	buf[i] = 0;
 	hexy_reverse(buf, i);
+}
+
+HEXY_API int hexy_unum_to_string(char buf[/*static HEXY_PNUM_BUF_SIZE*/], hexy_unum_t in, hexy_unum_t base, bool upper) {
+	assert(buf);
+	if (!hexy_is_valid_base(base))
+		return HEXY_ELINE;
+	hexy_divider_t d;
+	if (base == 10)
+		d = hexy_divider_10;
+	else
+		hexy_divider_make(&d, base);
+	hexy_unum_digits(buf, in, &d, upper);
 	return 0;
 }
 
 HEXY_API int hexy_buffer_get(void *in) {
-	hexy_buffer_t *b = in;
+	hexy_buffer_t *b = (hexy_buffer_t*)in;
 	assert(b);
 	assert(b->b);
 	if (b->used >= b->length)
@@ -351,7 +819,7 @@ HEXY_API int hexy_buffer_get(void *in) {
 }
 
 HEXY_API int hexy_buffer_put(void *out, const int ch) {
-	hexy_buffer_t *b = out;
+	hexy_buffer_t *b = (hexy_buffer_t*)out;
 	assert(b);
 	assert(b->b);
 	if (b->used >= b->length)
@@ -361,7 +829,7 @@ HEXY_API int hexy_buffer_put(void *out, const int ch) {
 
 HEXY_API int hexy_file_get(void *in) {
 	assert(in);
-	return fgetc(in);
+	return fgetc((FILE*)in);
 }
 
 HEXY_API int hexy_file_put(void *out, int ch) {
@@ -369,12 +837,140 @@ HEXY_API int hexy_file_put(void *out, int ch) {
 	return fputc(ch, (FILE*)out);
 }
 
+HEXY_API int hexy_buffer_read(void *in, uint8_t *buf, size_t length) {
+	hexy_buffer_t *b = (hexy_buffer_t*)in;
+	assert(b);
+	assert(b->b);
+	assert(buf);
+	assert(length <= INT_MAX);
+	const size_t n = HEXY_MIN(length, b->length - b->used);
+	memcpy(buf, &b->b[b->used], n);
+	b->used += n;
+	return n;
+}
+
+HEXY_API int hexy_buffer_write(void *out, const char *buf, size_t length) {
+	hexy_buffer_t *b = (hexy_buffer_t*)out;
+	assert(b);
+	assert(b->b);
+	assert(buf);
+	assert(length <= INT_MAX);
+	if (length > (b->length - b->used))
+		return HEXY_ELINE;
+	memcpy(&b->b[b->used], buf, length);
+	b->used += length;
+	return length;
+}
+
+HEXY_API int hexy_file_read(void *in, uint8_t *buf, size_t length) {
+	assert(in);
+	assert(buf);
+	assert(length <= INT_MAX);
+	const size_t r = fread(buf, 1, length, (FILE*)in);
+	if (r < length && ferror((FILE*)in))
+		return HEXY_ELINE;
+	return r;
+}
+
+HEXY_API int hexy_file_write(void *out, const char *buf, size_t length) {
+	assert(out);
+	assert(buf);
+	assert(length <= INT_MAX);
+	if (fwrite(buf, 1, length, (FILE*)out) != length)
+		return HEXY_ELINE;
+	return length;
+}
+
+HEXY_API int hexy_buffer_seek(void *in, uint64_t offset) {
+	hexy_buffer_t *b = (hexy_buffer_t*)in;
+	assert(b);
+	b->used += HEXY_MIN(offset, (uint64_t)(b->length - b->used));
+	return 0;
+}
+
+HEXY_API int hexy_buffer_seek_to(void *in, uint64_t position) {
+	hexy_buffer_t *b = (hexy_buffer_t*)in;
+	assert(b);
+	b->used = HEXY_MIN(position, (uint64_t)b->length);
+	return 0;
+}
+
+HEXY_INTERNAL int hexy_file_move(FILE *f, uint64_t offset, int whence) {
+	assert(f);
+#if defined(_WIN32)
+	if (offset > INT64_MAX)
+		return HEXY_ELINE;
+	return _fseeki64(f, offset, whence) ? HEXY_ELINE : 0;
+#elif defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L
+	if ((sizeof (off_t) < sizeof (offset) && offset > (((uint64_t)1 << (sizeof (off_t) * CHAR_BIT - 1)) - 1)) || offset > INT64_MAX)
+		return HEXY_ELINE;
+	return fseeko(f, offset, whence) ? HEXY_ELINE : 0;
+#else
+	if (offset > LONG_MAX)
+		return HEXY_ELINE;
+	return fseek(f, offset, whence) ? HEXY_ELINE : 0;
+#endif
+}
+
+HEXY_API int hexy_file_seek(void *in, uint64_t offset) {
+	return hexy_file_move((FILE*)in, offset, SEEK_CUR);
+}
+
+HEXY_API int hexy_file_seek_to(void *in, uint64_t position) {
+	return hexy_file_move((FILE*)in, position, SEEK_SET);
+}
+
+/* Memory for anything that does not fit on the stack comes from here, it
+ * is taken from `arena` if there is room and from the heap otherwise (or
+ * not at all if `HEXY_NO_HEAP` is defined). An arena is used like a stack,
+ * the caller notes `arena->used` and puts it back once done, `hexy_release`
+ * must still be called on each allocation in case it came from the heap. */
+HEXY_INTERNAL void *hexy_alloc(hexy_buffer_t *arena, size_t size, bool zero) {
+	assert(arena);
+	HEXY_BUILD_BUG_ON(HEXY_ARENA_ALIGN & (HEXY_ARENA_ALIGN - 1));
+	void *r = NULL;
+	if (arena->b) {
+		const size_t pad = (HEXY_ARENA_ALIGN - ((uintptr_t)&arena->b[arena->used] & (HEXY_ARENA_ALIGN - 1))) & (HEXY_ARENA_ALIGN - 1);
+		if (arena->used <= arena->length && (arena->length - arena->used) >= pad && (arena->length - arena->used - pad) >= size) {
+			r = &arena->b[arena->used + pad];
+			arena->used += pad + size;
+			if (zero)
+				memset(r, 0, size);
+			return r;
+		}
+	}
+#ifndef HEXY_NO_HEAP
+	r = zero ? calloc(1, size) : malloc(size);
+#endif
+	return r;
+}
+
+HEXY_INTERNAL void hexy_release(hexy_buffer_t *arena, void *p) {
+	assert(arena);
+	const uint8_t *b = (const uint8_t*)p;
+	if (!b || (arena->b && b >= arena->b && b < &arena->b[arena->length]))
+		return;
+#ifndef HEXY_NO_HEAP
+	free(p);
+#endif
+}
+
+/* Would `count` allocations totalling `size` bytes fit in what is left of `arena`? */
+HEXY_INTERNAL bool hexy_arena_fits(const hexy_buffer_t *arena, size_t count, size_t size) {
+	assert(arena);
+	if (!arena->b || arena->used > arena->length)
+		return false;
+	const size_t left = arena->length - arena->used, slack = count * (HEXY_ARENA_ALIGN - 1);
+	return left >= slack && (left - slack) >= size;
+}
+
 HEXY_API int hexy_get(hexy_io_t *io) {
 	assert(io);
 	if (io->error)
 		return HEXY_ELINE;
 	const int r = io->get(io->in);
 	assert(r <= 255);
+	HEXY_STAT(io, reads, 1);
 	io->read += r >= 0;
 	return r;
 }
@@ -385,19 +981,101 @@ HEXY_API int hexy_put(hexy_io_t *io, const int ch) {
 		return HEXY_ELINE;
 	const int r = io->put(io->out, ch);
 	assert(r <= 255);
+	HEXY_STAT(io, writes, 1);
 	io->wrote += r >= 0;
 	if (r < 0)
 		io->error = -1;
 	return r;
 }
 
-HEXY_API int hexy_puts(hexy_io_t *io, const char *s) {
-	for (int ch = 0; (ch = *s++);)
-		if (hexy_put(io, ch) < 0)
+/* Block reads and writes use the optional `read_block`/`write_block`
+ * callbacks if they are present and fall back to the per byte `get`/`put`
+ * callbacks otherwise, so a port only has to provide the latter. A read
+ * is retried until `length` bytes are available or the source is exhausted,
+ * a short count is returned on EOF. */
+HEXY_INTERNAL int hexy_do_read(hexy_io_t *io, uint8_t *buf, size_t length) {
+	assert(io);
+	assert(buf);
+	assert(length <= INT_MAX);
+	if (io->error)
+		return HEXY_ELINE;
+	size_t i = 0;
+	if (io->read_block) {
+		while (i < length) {
+			const int r = io->read_block(io->in, &buf[i], length - i);
+			HEXY_STAT(io, reads, 1);
+			if (r < 0) {
+				io->error = -1;
+				return HEXY_ELINE;
+			}
+			if (r == 0)
+				break;
+			assert((size_t)r <= (length - i));
+			i += r;
+		}
+		io->read += i;
+		return i;
+	}
+	for (; i < length; i++) { /* `io->error` was checked above, the callback is called directly and counted after */
+		const int ch = io->get(io->in);
+		if (ch < 0)
+			break;
+		buf[i] = ch;
+	}
+	HEXY_STAT(io, reads, i + (i < length));
+	io->read += i;
+	return i;
+}
+
+HEXY_API int hexy_read(hexy_io_t *io, uint8_t *buf, size_t length) {
+	assert(io);
+	const uint64_t start = HEXY_CLOCK(io);
+	const int r = hexy_do_read(io, buf, length);
+	HEXY_STAT(io, io_time, HEXY_CLOCK(io) - start);
+	return r;
+}
+
+HEXY_INTERNAL int hexy_do_write(hexy_io_t *io, const char *buf, size_t length) {
+	assert(io);
+	assert(buf);
+	assert(length <= INT_MAX);
+	if (io->error)
+		return HEXY_ELINE;
+	if (io->write_block) {
+		const int r = length ? io->write_block(io->out, buf, length) : 0;
+		HEXY_STAT(io, writes, length != 0);
+		if (r < 0 || (size_t)r != length) {
+			io->error = -1;
 			return HEXY_ELINE;
+		}
+		io->wrote += length;
+		return 0;
+	}
+	size_t i = 0;
+	while (i < length && io->put(io->out, (uint8_t)buf[i]) >= 0)
+		i++;
+	HEXY_STAT(io, writes, i + (i < length));
+	io->wrote += i;
+	if (i < length) {
+		io->error = -1;
+		return HEXY_ELINE;
+	}
 	return 0;
 }
 
+HEXY_API int hexy_write(hexy_io_t *io, const char *buf, size_t length) {
+	assert(io);
+	const uint64_t start = HEXY_CLOCK(io);
+	const int r = hexy_do_write(io, buf, length);
+	HEXY_STAT(io, io_time, HEXY_CLOCK(io) - start);
+	return r;
+}
+
+HEXY_API int hexy_puts(hexy_io_t *io, const char *s) {
+	assert(s);
+	return hexy_write(io, s, strlen(s));
+}
+
 HEXY_INTERNAL int hexy_hex_char_to_nibble(int c) {
 	c = hexy_tolower(c);
 	if ('a' <= c && c <= 'f')
@@ -459,90 +1137,681 @@ HEXY_API int hexy_unescape(char *r, size_t length) { /* N.B. In place un-escapin
 	return k;
 }
 
-HEXY_INTERNAL int hexy_print_number(hexy_io_t *io, hexy_unum_t u, hexy_unum_t base, int char_count, int char_to_repeat, bool left_align, bool upper) {
-	assert(io);
-	if (left_align)
-		for (int i = 0; i < char_count; i++)
-			if (hexy_put(io, char_to_repeat) < 0)
-				return HEXY_ELINE;
+/* Numbers are formatted into `out`, which must have room for at least
+ * `HEXY_PNUM_BUF_SIZE` plus `char_count` characters, no NUL terminator
+ * is added and the number of characters written is returned. */
+HEXY_INTERNAL int hexy_print_number(char *out, hexy_unum_t u, const hexy_divider_t *d, int char_count, int char_to_repeat, bool left_align, bool upper) {
+	assert(out);
+	assert(d);
 	char buf[HEXY_PNUM_BUF_SIZE] = { 0, };
-	if (hexy_unum_to_string(buf, u, base, upper) < 0)
-		return HEXY_ELINE;
-	for (size_t i = 0; i < HEXY_PNUM_BUF_SIZE && buf[i]; i++)
-		if (hexy_put(io, buf[i]) < 0)
-			return HEXY_ELINE;
-	if (!left_align)
-		for (int i = 0; i < char_count; i++)
-			if (hexy_put(io, char_to_repeat) < 0)
-				return HEXY_ELINE;
-	return 0;
+	hexy_unum_digits(buf, u, d, upper);
+	const size_t digits = strlen(buf), pad = HEXY_MAX(char_count, 0);
+	if (left_align) {
+		memset(out, char_to_repeat, pad);
+		memcpy(&out[pad], buf, digits);
+	} else {
+		memcpy(out, buf, digits);
+		memset(&out[digits], char_to_repeat, pad);
+	}
+	return digits + pad;
 }
 
+/* Number of digits in `n` written in `base`, counted by multiplying up
+ * a power of `base` until it is bigger than `n` (or would overflow) so
+ * that no division is needed. */
 HEXY_API int hexy_unsigned_integer_logarithm(hexy_unum_t n, hexy_unum_t base) {
-	int r = 0;
-	do r++; while ((n /= base));
+	assert(base >= 2);
+	int r = 1;
+	for (uint64_t p = base; p <= n; p *= base) {
+		r++;
+		if (hexy_mulhi64(p, base))
+			break;
+	}
 	return r;
 }
 
-HEXY_INTERNAL int hexy_aligned_print_number(hexy_io_t *io, hexy_unum_t u, hexy_unum_t base, hexy_unum_t max, int leading_zeros, int leading_char, bool upper) {
-	assert(io);
-	const int mint = hexy_unsigned_integer_logarithm(max, base) - hexy_unsigned_integer_logarithm(u, base);
+HEXY_INTERNAL int hexy_aligned_print_number(char *out, hexy_unum_t u, const hexy_divider_t *d, hexy_unum_t max, int leading_zeros, int leading_char, bool upper) {
+	assert(out);
+	assert(d);
+	const int mint = hexy_unsigned_integer_logarithm(max, d->base) - hexy_unsigned_integer_logarithm(u, d->base);
 	leading_zeros = HEXY_MAX(0, leading_zeros);
 	leading_zeros = HEXY_MIN(mint, leading_zeros);
-	return hexy_print_number(io, u, base, leading_zeros, leading_char, true, upper);
+	return hexy_print_number(out, u, d, leading_zeros, leading_char, true, upper);
 }
 
-HEXY_INTERNAL bool hexy_newlines_enabled(hexy_t *h) {
-	if (!h->newlines_off)
-		return true;
-	if (!h->chars_off)
-		return true;
-	if (!h->addresses_off)
-		return true;
-	return false;
+HEXY_INTERNAL void hexy_hex_encode_scalar(const uint8_t *in, size_t length, char *out, bool upper) {
+	assert(in);
+	assert(out);
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	for (size_t i = 0; i < length; i++) {
+		out[(i * 2) + 0] = digits[in[i] >> 4];
+		out[(i * 2) + 1] = digits[in[i] & 15];
+	}
 }
 
-HEXY_INTERNAL int hexy_newline(hexy_t *h) {
-	assert(h);
-	if (hexy_newlines_enabled(h))
-		if (hexy_puts(&h->io, h->sep_eol) < 0)
-			return HEXY_ELINE;
-	return 0;
+/* Convert `length` bytes into `2 * length` hexadecimal digits, blocks of
+ * sixteen bytes are split into nibbles, interleaved, and turned into
+ * characters by adding '0' and, for nibbles above nine, the distance to
+ * 'a' (or 'A'), the remainder is handled by `hexy_hex_encode_scalar`
+ * which is also the reference these versions are tested against. */
+HEXY_API void hexy_hex_encode(const uint8_t *in, size_t length, char *out, bool upper) {
+	assert(in);
+	assert(out);
+	size_t i = 0;
+#if defined(HEXY_SIMD_SSE2)
+	const __m128i mask = _mm_set1_epi8(0x0f), nine = _mm_set1_epi8(9), zero = _mm_set1_epi8('0');
+	const __m128i alpha = _mm_set1_epi8((upper ? 'A' : 'a') - '0' - 10);
+	for (; (i + 16) <= length; i += 16) {
+		const __m128i v  = _mm_loadu_si128((const __m128i*)&in[i]);
+		const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		const __m128i lo = _mm_and_si128(v, mask);
+		__m128i a = _mm_unpacklo_epi8(hi, lo), b = _mm_unpackhi_epi8(hi, lo);
+		a = _mm_add_epi8(_mm_add_epi8(a, zero), _mm_and_si128(_mm_cmpgt_epi8(a, nine), alpha));
+		b = _mm_add_epi8(_mm_add_epi8(b, zero), _mm_and_si128(_mm_cmpgt_epi8(b, nine), alpha));
+		_mm_storeu_si128((__m128i*)&out[(i * 2) +  0], a);
+		_mm_storeu_si128((__m128i*)&out[(i * 2) + 16], b);
+	}
+#elif defined(HEXY_SIMD_NEON)
+	const uint8x16_t mask = vdupq_n_u8(0x0f), nine = vdupq_n_u8(9), zero = vdupq_n_u8('0');
+	const uint8x16_t alpha = vdupq_n_u8((upper ? 'A' : 'a') - '0' - 10);
+	for (; (i + 16) <= length; i += 16) {
+		const uint8x16_t v = vld1q_u8(&in[i]);
+		uint8x16x2_t z = vzipq_u8(vshrq_n_u8(v, 4), vandq_u8(v, mask));
+		z.val[0] = vaddq_u8(vaddq_u8(z.val[0], zero), vandq_u8(vcgtq_u8(z.val[0], nine), alpha));
+		z.val[1] = vaddq_u8(vaddq_u8(z.val[1], zero), vandq_u8(vcgtq_u8(z.val[1], nine), alpha));
+		vst1q_u8((uint8_t*)&out[(i * 2) +  0], z.val[0]);
+		vst1q_u8((uint8_t*)&out[(i * 2) + 16], z.val[1]);
+	}
+#endif
+	hexy_hex_encode_scalar(&in[i], length - i, &out[i * 2], upper);
 }
 
-HEXY_INTERNAL int hexy_space(hexy_t *h) {
-	assert(h);
-	if (hexy_put(&h->io, ' ') < 0)
-		return HEXY_ELINE;
-	return 0;
-}
+/* Tables of 256 entries are generated at compile time by applying `F` to
+ * each index, for example `HEXY_TABLE(HEXY_CH)`. */
+#define HEXY_TABLE4(F, X)  F(X), F((X) + 1), F((X) + 2), F((X) + 3)
+#define HEXY_TABLE16(F, X) HEXY_TABLE4(F, X),  HEXY_TABLE4(F, (X) + 4),   HEXY_TABLE4(F, (X) + 8),   HEXY_TABLE4(F, (X) + 12)
+#define HEXY_TABLE64(F, X) HEXY_TABLE16(F, X), HEXY_TABLE16(F, (X) + 16), HEXY_TABLE16(F, (X) + 32), HEXY_TABLE16(F, (X) + 48)
+#define HEXY_TABLE(F)      HEXY_TABLE64(F, 0), HEXY_TABLE64(F, 64),       HEXY_TABLE64(F, 128),      HEXY_TABLE64(F, 192)
 
-HEXY_INTERNAL int hexy_spaces(hexy_t *h, int spaces) {
-	assert(h);
-	spaces = HEXY_MAX(spaces, 0);
-	for (int i = 0; i < spaces; i++)
-		if (hexy_space(h) < 0)
-			return HEXY_ELINE;
-	return 0;
-}
+#define HEXY_CH(X) ((char)(((X) > 32 && (X) < 127) ? (X) : HEXY_NON_GRAPHIC_REPLACEMENT_CHAR))
+static const char hexy_char_table[256] = { HEXY_TABLE(HEXY_CH) }; /* `hexy_isgraph` as a table, for the character view */
+#undef HEXY_CH
 
-HEXY_INTERNAL int hexy_print_byte(hexy_t *h, int ch) {
+enum { /* classes of byte for colouring, each has an escape sequence in `hexy_colors` */
+	HEXY_CLASS_NUL_E,     /* 0x00 */
+	HEXY_CLASS_GRAPH_E,   /* printable ASCII */
+	HEXY_CLASS_SPACE_E,   /* ASCII whitespace */
+	HEXY_CLASS_CONTROL_E, /* the rest of ASCII */
+	HEXY_CLASS_HIGH_E,    /* the high bit is set */
+	HEXY_CLASS_FF_E,      /* 0xff */
+};
+
+#define HEXY_CLASS(X) ((uint8_t)(\
+	(X) == 0x00 ? HEXY_CLASS_NUL_E :\
+	(X) == 0xff ? HEXY_CLASS_FF_E :\
+	(X) > 32 && (X) < 127 ? HEXY_CLASS_GRAPH_E :\
+	(X) == ' ' || ((X) >= '\t' && (X) <= '\r') ? HEXY_CLASS_SPACE_E :\
+	(X) < 128 ? HEXY_CLASS_CONTROL_E : HEXY_CLASS_HIGH_E))
+static const uint8_t hexy_class_table[256] = { HEXY_TABLE(HEXY_CLASS) }; /* class of each byte, for colouring */
+#undef HEXY_CLASS
+
+static const char hexy_colors[][HEXY_COLOR_LENGTH + 1] = { /* all the same length so they are copied with a constant size */
+	"\x1b[90m", /* NUL: grey */
+	"\x1b[36m", /* printable: cyan */
+	"\x1b[32m", /* whitespace: green */
+	"\x1b[35m", /* control: magenta */
+	"\x1b[33m", /* high bit: yellow */
+	"\x1b[31m", /* 0xff: red */
+};
+
+/* Start the colour of byte `b` in `line`, unless its class is the one in
+ * effect (`*last`, -1 if there is none), so a run of bytes of the same
+ * class shares one escape sequence. The escape is always copied and only
+ * kept if the class changed, as on mixed data a branch on it would often
+ * be mispredicted, `line` needs room for it either way. */
+HEXY_FORCE_INLINE size_t hexy_color_escape(char *line, size_t used, int *last, uint8_t b) {
+	const int c = hexy_class_table[b];
+	memcpy(&line[used], hexy_colors[c], HEXY_COLOR_LENGTH);
+	used += HEXY_COLOR_LENGTH & (0 - (size_t)(c != *last)); /* a mask, not a branch, class changes are unpredictable */
+	*last = c;
+	return used;
+}
+
+/* Render `length` bytes for the character view into `out`, replacing
+ * non-graphic characters with `HEXY_NON_GRAPHIC_REPLACEMENT_CHAR`. This
+ * is done sixteen bytes at a time with a compare and select where SIMD is
+ * available, and with a table lookup otherwise and for the remainder. */
+HEXY_API void hexy_render_chars(const uint8_t *in, size_t length, char *out) {
+	assert(in);
+	assert(out);
+	size_t i = 0;
+#if defined(HEXY_SIMD_SSE2)
+	const __m128i lo = _mm_set1_epi8(32), hi = _mm_set1_epi8(127);
+	const __m128i rep = _mm_set1_epi8(HEXY_NON_GRAPHIC_REPLACEMENT_CHAR);
+	for (; (i + 16) <= length; i += 16) { /* signed compares: bytes above 127 are negative */
+		const __m128i v = _mm_loadu_si128((const __m128i*)&in[i]);
+		const __m128i m = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+		_mm_storeu_si128((__m128i*)&out[i], _mm_or_si128(_mm_and_si128(m, v), _mm_andnot_si128(m, rep)));
+	}
+#elif defined(HEXY_SIMD_NEON)
+	const uint8x16_t lo = vdupq_n_u8(32), hi = vdupq_n_u8(127);
+	const uint8x16_t rep = vdupq_n_u8(HEXY_NON_GRAPHIC_REPLACEMENT_CHAR);
+	for (; (i + 16) <= length; i += 16) {
+		const uint8x16_t v = vld1q_u8(&in[i]);
+		const uint8x16_t m = vandq_u8(vcgtq_u8(v, lo), vcltq_u8(v, hi));
+		vst1q_u8((uint8_t*)&out[i], vbslq_u8(m, v, rep));
+	}
+#endif
+	for (; i < length; i++)
+		out[i] = hexy_char_table[in[i]];
+}
+
+HEXY_INTERNAL bool hexy_newlines_enabled(hexy_t *h) {
+	if (!h->newlines_off)
+		return true;
+	if (!h->chars_off)
+		return true;
+	if (!h->addresses_off)
+		return true;
+	return false;
+}
+
+HEXY_INTERNAL int hexy_newline(hexy_t *h) {
 	assert(h);
-	ch = hexy_isgraph(ch) ? ch : HEXY_NON_GRAPHIC_REPLACEMENT_CHAR;
-	if (hexy_put(&h->io, ch) < 0)
-		return HEXY_ELINE;
+	if (h->format == HEXY_FORMAT_HEXDUMP_E && hexy_newlines_enabled(h))
+		if (hexy_write(&h->io, h->sep.eol.b, h->sep.eol.length) < 0)
+			return HEXY_ELINE;
 	return 0;
 }
 
-HEXY_INTERNAL int hexy_print_address(hexy_t *h, hexy_unum_t addr) {
+HEXY_INTERNAL size_t hexy_cat(char *line, size_t used, const char *s, size_t length) {
+	assert(line);
+	assert(s);
+	assert((used + length) <= HEXY_LINE_BUF_SIZE);
+	memcpy(&line[used], s, length);
+	return used + length;
+}
+
+HEXY_INTERNAL size_t hexy_pad(char *line, size_t used, int ch, int count) {
+	assert(line);
+	count = HEXY_MAX(count, 0);
+	assert((used + count) <= HEXY_LINE_BUF_SIZE);
+	memset(&line[used], ch, count);
+	return used + count;
+}
+
+HEXY_INTERNAL char hexy_counter_digit(const hexy_counter_t *c, int v) {
+	assert(c);
+	assert(v >= 0 && v < 36);
+	static const char *digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+	return c->upper ? hexy_toupper(digits[v]) : digits[v];
+}
+
+HEXY_INTERNAL void hexy_counter_set(hexy_counter_t *c, uint64_t at, const hexy_divider_t *d, bool upper) {
+	assert(c);
+	assert(d);
+	assert(hexy_is_valid_base(d->base));
+	c->at = at;
+	c->base = d->base;
+	c->div = *d;
+	c->upper = upper;
+	c->legacy = hexy_unsigned_integer_logarithm(65535, d->base);
+	c->length = 0;
+	do {
+		const int i = HEXY_NELEMS(c->v) - ++c->length, v = hexy_divmod(d, &at);
+		c->v[i] = v;
+		c->s[i] = hexy_counter_digit(c, v);
+	} while (at);
+}
+
+/* Add `n` to the counter a digit at a time starting from the lowest, which
+ * stops once there is nothing left to add and no carry, so moving on by
+ * a row usually only touches one or two digits. */
+HEXY_INTERNAL void hexy_counter_add(hexy_counter_t *c, uint64_t n) {
+	assert(c);
+	assert((c->at + n) >= c->at);
+	const int base = c->base;
+	c->at += n;
+	for (int i = HEXY_NELEMS(c->v) - 1; n; i--) {
+		assert(i >= 0);
+		const bool fresh = i < ((int)HEXY_NELEMS(c->v) - c->length);
+		const uint64_t sum = (fresh ? 0 : c->v[i]) + hexy_divmod(&c->div, &n);
+		const bool carry = sum >= (uint64_t)base;
+		const int v = carry ? sum - base : sum;
+		n += carry;
+		c->v[i] = v;
+		c->s[i] = hexy_counter_digit(c, v);
+		c->length += fresh;
+	}
+}
+
+/* Print the number in `hi` and `lo` as exactly `width` digits, zero padded. */
+HEXY_FORCE_INLINE void hexy_word_digits(char *out, int width, uint64_t hi, uint64_t lo, const hexy_divider_t *d, bool upper) {
+	assert(out);
+	const char *digits = upper ? "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ" : "0123456789abcdefghijklmnopqrstuvwxyz";
+	for (int i = width - 1; i >= 0; i--)
+		out[i] = digits[hi ? hexy_divmod128(&hi, &lo, d) : hexy_divmod(d, &lo)];
+	assert(!hi && !lo);
+}
+
+HEXY_INTERNAL void hexy_word(char *out, int width, uint64_t hi, uint64_t lo, const hexy_divider_t *d, bool upper) {
+	switch (d->base) { /* with a constant divider the multiplier and shifts are folded in */
+	case 8:  hexy_word_digits(out, width, hi, lo, &hexy_divider_8,  upper); break;
+	case 10: hexy_word_digits(out, width, hi, lo, &hexy_divider_10, upper); break;
+	default: hexy_word_digits(out, width, hi, lo, d, upper); break;
+	}
+}
+
+/* The `width` zero padded digits of byte `b` in `h->base`, from the digit
+ * table or, without one, made with the divider. */
+HEXY_FORCE_INLINE void hexy_byte_digits(const hexy_t *h, char *out, uint8_t b, int width) {
+	assert(h);
+	assert(out);
+#ifdef HEXY_NO_DIGIT_TABLE
+	hexy_word(out, width, 0, b, &h->bdiv, h->uppercase_on);
+#else
+	memcpy(out, h->digits[b], width);
+#endif
+}
+
+/* In bases that are a power of two that divides into eight bits a word has
+ * the same digits as its bytes printed one after another. */
+HEXY_INTERNAL bool hexy_words_are_bytes(int base) {
+	return base == 2 || base == 4 || base == 16;
+}
+
+/* Render `h->address` into `line`, padded with spaces to `h->awidth`
+ * characters or, if that is not set, towards the width of 65535 by up
+ * to four characters (which is what has always been done). */
+HEXY_INTERNAL hexy_counter_t *hexy_address_counter(hexy_t *h) {
+	assert(h);
+	hexy_counter_t *c = &h->counter;
+	if (c->base != h->abase || c->upper != h->uppercase_on || h->address < c->at)
+		hexy_counter_set(c, h->address, &h->adiv, h->uppercase_on);
+	else if (h->address != c->at)
+		hexy_counter_add(c, h->address - c->at);
+	assert(c->at == h->address);
+	return c;
+}
+
+HEXY_INTERNAL int hexy_render_address(hexy_t *h, char *line) {
+	assert(h);
+	assert(line);
+	const hexy_counter_t *c = hexy_address_counter(h);
+	const int pad = h->awidth ? h->awidth - c->length : HEXY_MIN(c->legacy - c->length, 4);
+	const size_t used = hexy_pad(line, 0, ' ', pad);
+	return hexy_cat(line, used, &c->s[HEXY_NELEMS(c->s) - c->length], c->length);
+}
+
+/* Render the row held in `h->buf` into `line`, which must be at least
+ * `HEXY_LINE_BUF_SIZE` bytes long, so it can be output with a single
+ * write. The row consists of the address, the bytes, the character view
+ * and the end of line separator, depending on which of those are turned
+ * on. The number of characters placed in `line` is returned, `line` is
+ * not NUL terminated.
+ *
+ * The layout is passed in separately from `h` so that, when the function
+ * is inlined into a caller that uses constants for `base`, `group`, `ncols`
+ * and `flags` (see `hexy_renderer` and `hexy_dumper`), the digit width and
+ * loop bounds are folded and the row loop can be unrolled. */
+HEXY_FORCE_INLINE int hexy_render_core(hexy_t *h, char *line, const int base, const int group, const int ncols, const unsigned flags) {
+	assert(h);
+	assert(line);
+	assert(h->buf_used <= sizeof (h->buf));
+	assert(h->base == base && h->group == group && h->ncols == ncols);
+	assert(h->digits_base == base);
+	const int byte_align = HEXY_BYTE_WIDTH(base);
+	assert(byte_align == h->digits_width);
+	const size_t byt = h->sep.byt.length;
+	size_t used = 0;
+
+	if (flags & HEXY_ROW_ADDRESSES_E) {
+		used = hexy_render_address(h, line);
+		used = hexy_cat(line, used, h->sep.adr.b, h->sep.adr.length);
+	}
+
+	const int missing = (ncols * group) - h->buf_used;
+	assert(missing >= 0);
+	int pad = byte_align * missing; /* digits to pad the character view with */
+
+	if ((flags & HEXY_ROW_WORDS_E) && !hexy_words_are_bytes(base)) {
+		pad = ncols * h->word_width[group];
+		for (size_t i = 0, idx = 0; i < (size_t)ncols; i++) {
+			const int n = HEXY_MIN((size_t)group, h->buf_used - idx);
+			if (n > 0) { /* a partial last group is printed as a smaller word */
+				uint64_t hi = 0, lo = 0;
+				const int width = h->word_width[n];
+				hexy_load_word(&h->buf[idx], n, &hi, &lo);
+				assert((used + width) <= HEXY_LINE_BUF_SIZE);
+				hexy_word(&line[used], width, hi, lo, &h->bdiv, h->uppercase_on);
+				used += width;
+				pad -= width;
+				idx += n;
+			}
+			used = hexy_cat(line, used, h->sep.byt.b, byt);
+		}
+	} else if (flags & HEXY_ROW_COLOR_E) { /* the digits are made first in arrays that `line` cannot alias */
+		assert((used + (ncols * byt) + (h->buf_used * (byte_align + HEXY_COLOR_LENGTH)) + HEXY_COLOR_LENGTH) <= HEXY_LINE_BUF_SIZE);
+		const size_t n = h->buf_used;
+		uint8_t b[sizeof (h->buf)];
+		char digits[sizeof (h->buf) * HEXY_BYTE_WIDTH(2)], sep[HEXY_MAX_SEP + 1];
+		memcpy(b, h->buf, n);
+		memcpy(sep, h->sep.byt.b, byt);
+		if (base == 16)
+			hexy_hex_encode(b, n, digits, h->uppercase_on);
+		else
+			for (size_t i = 0; i < n; i++)
+				hexy_byte_digits(h, &digits[i * byte_align], b[i], byte_align);
+		int last = -1;
+		for (size_t i = 0, idx = 0; i < (size_t)ncols; i++) {
+			for (size_t j = 0; j < (size_t)group && idx < n; j++, idx++, used += byte_align) {
+				used = hexy_color_escape(line, used, &last, b[idx]);
+				if (byte_align == 2) /* a fixed size copy is not a call */
+					memcpy(&line[used], &digits[idx * 2], 2);
+				else
+					memcpy(&line[used], &digits[idx * byte_align], byte_align);
+			}
+			if (byt == 1)
+				line[used] = sep[0];
+			else
+				memcpy(&line[used], sep, byt);
+			used += byt;
+		}
+		if (last >= 0)
+			used = hexy_cat(line, used, HEXY_COLOR_RESET, sizeof (HEXY_COLOR_RESET) - 1);
+	} else if (base == 16) { /* the common case, digits of a group are contiguous */
+		char hex[sizeof (h->buf) * 2];
+		const size_t width = group * 2;
+		hexy_hex_encode(h->buf, h->buf_used, hex, h->uppercase_on);
+		for (size_t i = 0, idx = 0; i < (size_t)ncols; i++) {
+			const size_t n = HEXY_MIN(width, (h->buf_used * 2) - idx);
+			if (width == 2 && n == 2) {
+				assert((used + 2) <= HEXY_LINE_BUF_SIZE);
+				line[used++] = hex[idx++];
+				line[used++] = hex[idx++];
+			} else {
+				used = hexy_cat(line, used, &hex[idx], n);
+				idx += n;
+			}
+			if (byt == 1)
+				line[used++] = h->sep.byt.b[0];
+			else
+				used = hexy_cat(line, used, h->sep.byt.b, byt);
+		}
+	} else { /* the bounds are checked for the whole row, not for each digit */
+		assert((used + (ncols * ((group * byte_align) + byt))) <= HEXY_LINE_BUF_SIZE);
+		const bool full = !missing; /* only the last row of an input can be partial */
+		for (size_t i = 0, idx = 0; i < (size_t)ncols; i++) {
+			for (size_t j = 0; j < (size_t)group && (full || idx < h->buf_used); j++, idx++, used += byte_align)
+				hexy_byte_digits(h, &line[used], h->buf[idx], byte_align);
+			memcpy(&line[used], h->sep.byt.b, byt);
+			used += byt;
+		}
+	}
+
+	if (flags & HEXY_ROW_CHARS_E) {
+		used = hexy_pad(line, used, ' ', pad);
+		used = hexy_cat(line, used, h->sep.ch1.b, h->sep.ch1.length);
+		if (flags & HEXY_ROW_COLOR_E) {
+			assert((used + (h->buf_used * (1 + HEXY_COLOR_LENGTH)) + HEXY_COLOR_LENGTH) <= HEXY_LINE_BUF_SIZE);
+			const size_t n = h->buf_used;
+			uint8_t b[sizeof (h->buf)];
+			char chars[sizeof (h->buf)];
+			memcpy(b, h->buf, n);
+			hexy_render_chars(b, n, chars);
+			int last = -1;
+			for (size_t i = 0; i < n; i++) {
+				used = hexy_color_escape(line, used, &last, b[i]);
+				line[used++] = chars[i];
+			}
+			if (last >= 0)
+				used = hexy_cat(line, used, HEXY_COLOR_RESET, sizeof (HEXY_COLOR_RESET) - 1);
+		} else {
+			assert((used + h->buf_used) <= HEXY_LINE_BUF_SIZE);
+			hexy_render_chars(h->buf, h->buf_used, &line[used]);
+			used += h->buf_used;
+		}
+		used = hexy_pad(line, used, ' ', missing);
+		used = hexy_cat(line, used, h->sep.ch2.b, h->sep.ch2.length);
+	}
+
+	if (flags & HEXY_ROW_NEWLINES_E)
+		used = hexy_cat(line, used, h->sep.eol.b, h->sep.eol.length);
+	assert(used <= HEXY_LINE_BUF_SIZE);
+	return used;
+}
+
+HEXY_INTERNAL unsigned hexy_row_flags(hexy_t *h) {
+	assert(h);
+	unsigned flags = 0;
+	flags |= h->chars_off     ? 0 : HEXY_ROW_CHARS_E;
+	flags |= h->addresses_off ? 0 : HEXY_ROW_ADDRESSES_E;
+	flags |= hexy_newlines_enabled(h) ? HEXY_ROW_NEWLINES_E : 0;
+	flags |= h->rev_grp_on ? HEXY_ROW_REVERSE_E : 0;
+	flags |= h->words_on && !hexy_words_are_bytes(h->base) ? HEXY_ROW_WORDS_E : 0;
+	flags |= h->color_on && h->format == HEXY_FORMAT_HEXDUMP_E ? HEXY_ROW_COLOR_E : 0;
+	return flags;
+}
+
+HEXY_INTERNAL int hexy_render_row(hexy_t *h, char *line) {
+	return hexy_render_core(h, line, h->base, h->group, h->ncols, hexy_row_flags(h));
+}
+
+#define HEXY_ROW_CLASSIC (HEXY_ROW_CHARS_E | HEXY_ROW_ADDRESSES_E | HEXY_ROW_NEWLINES_E)
+#define HEXY_RENDER_PRESET(NAME, BASE, GROUP, NCOLS, FLAGS)\
+	HEXY_INTERNAL int NAME(hexy_t *h, char *line) {\
+		return hexy_render_core(h, line, (BASE), (GROUP), (NCOLS), (FLAGS) & ~(unsigned)HEXY_ROW_REVERSE_E);\
+	}
+
+HEXY_RENDER_PRESET(hexy_render_16_1_16, 16, 1, 16, HEXY_ROW_CLASSIC)
+HEXY_RENDER_PRESET(hexy_render_16_2_8,  16, 2,  8, HEXY_ROW_CLASSIC)
+HEXY_RENDER_PRESET(hexy_render_16_4_4,  16, 4,  4, HEXY_ROW_CLASSIC)
+HEXY_RENDER_PRESET(hexy_render_16_1_16_raw, 16, 1, 16, 0) /* as used by `-R` */
+HEXY_RENDER_PRESET(hexy_render_16_1_16_color, 16, 1, 16, HEXY_ROW_CLASSIC | HEXY_ROW_COLOR_E)
+
+/* The renderers for the other output formats, they share the digit
+ * table, `hexy_hex_encode` and the character table with the hex-dump one
+ * and are driven by the same loop, so reading, squeezing and the push
+ * interface work the same for them. Each ends a row with `sep_eol`. */
+
+HEXY_INTERNAL size_t hexy_cat_digits(hexy_t *h, char *line, size_t used, const uint8_t *b, size_t length) {
+	assert(h);
+	assert(line);
+	assert((used + (length * h->digits_width)) <= HEXY_LINE_BUF_SIZE);
+	if (h->base == 16) {
+		hexy_hex_encode(b, length, &line[used], h->uppercase_on);
+		return used + (length * 2);
+	}
+	for (size_t i = 0; i < length; i++, used += h->digits_width)
+		hexy_byte_digits(h, &line[used], b[i], h->digits_width);
+	return used;
+}
+
+HEXY_INTERNAL size_t hexy_cat_decimal(char *line, size_t used, uint64_t u) {
+	assert(line);
+	char d[20];
+	size_t n = 0;
+	do d[n++] = '0' + hexy_divmod(&hexy_divider_10, &u); while (u);
+	while (n)
+		line[used++] = d[--n];
+	return used;
+}
+
+HEXY_INTERNAL int hexy_render_c(hexy_t *h, char *line) { /* always hexadecimal, "\t0x00, 0x01,\n" */
+	assert(h);
+	assert(line);
+	char hex[sizeof (h->buf) * 2];
+	size_t used = 0;
+	hexy_hex_encode(h->buf, h->buf_used, hex, h->uppercase_on);
+	line[used++] = '\t';
+	for (size_t i = 0; i < h->buf_used; i++) {
+		if (i)
+			line[used++] = ' ';
+		line[used++] = '0';
+		line[used++] = 'x';
+		line[used++] = hex[(i * 2) + 0];
+		line[used++] = hex[(i * 2) + 1];
+		line[used++] = ',';
+	}
+	used = hexy_cat(line, used, h->sep.eol.b, h->sep.eol.length);
+	assert(used <= HEXY_LINE_BUF_SIZE);
+	return used;
+}
+
+HEXY_INTERNAL int hexy_render_json(hexy_t *h, char *line) { /* {"address":0,"bytes":"...","chars":"..."} */
+	assert(h);
+	assert(line);
+	size_t used = hexy_cat(line, 0, "{", 1);
+	if (!h->addresses_off) {
+		used = hexy_cat(line, used, "\"address\":", 10);
+		used = hexy_cat_decimal(line, used, h->address);
+		used = hexy_cat(line, used, ",", 1);
+	}
+	used = hexy_cat(line, used, "\"bytes\":\"", 9);
+	used = hexy_cat_digits(h, line, used, h->buf, h->buf_used);
+	used = hexy_cat(line, used, "\"", 1);
+	if (!h->chars_off) {
+		char chars[sizeof (h->buf)];
+		hexy_render_chars(h->buf, h->buf_used, chars);
+		used = hexy_cat(line, used, ",\"chars\":\"", 10);
+		for (size_t i = 0; i < h->buf_used; i++) { /* nothing else in the character view needs escaping */
+			if (chars[i] == '"' || chars[i] == '\\')
+				line[used++] = '\\';
+			line[used++] = chars[i];
+		}
+		used = hexy_cat(line, used, "\"", 1);
+	}
+	used = hexy_cat(line, used, "}", 1);
+	used = hexy_cat(line, used, h->sep.eol.b, h->sep.eol.length);
+	assert(used <= HEXY_LINE_BUF_SIZE);
+	return used;
+}
+
+HEXY_INTERNAL int hexy_render_plain(hexy_t *h, char *line) {
+	assert(h);
+	assert(line);
+	const size_t used = hexy_cat_digits(h, line, 0, h->buf, h->buf_used);
+	return hexy_cat(line, used, h->sep.eol.b, h->sep.eol.length);
+}
+
+HEXY_INTERNAL size_t hexy_cat_od_address(hexy_t *h, char *line, size_t used) {
+	assert(h);
+	assert(line);
+	const hexy_counter_t *c = hexy_address_counter(h);
+	used = hexy_pad(line, used, '0', (h->awidth ? h->awidth : 7) - c->length);
+	return hexy_cat(line, used, &c->s[HEXY_NELEMS(c->s) - c->length], c->length);
+}
+
+HEXY_INTERNAL int hexy_render_od(hexy_t *h, char *line) { /* "0000000 00 01 02\n", each group is preceded by `sep_byt` */
+	assert(h);
+	assert(line);
+	const bool words = h->words_on && !hexy_words_are_bytes(h->base);
+	char hex[sizeof (h->buf) * 2];
+	if (h->base == 16)
+		hexy_hex_encode(h->buf, h->buf_used, hex, h->uppercase_on);
+	size_t used = h->addresses_off ? 0 : hexy_cat_od_address(h, line, 0);
+	for (size_t idx = 0; idx < h->buf_used;) {
+		const size_t n = HEXY_MIN((size_t)h->group, h->buf_used - idx);
+		if (h->sep.byt.length == 1)
+			line[used++] = h->sep.byt.b[0];
+		else
+			used = hexy_cat(line, used, h->sep.byt.b, h->sep.byt.length);
+		if (words) {
+			uint64_t hi = 0, lo = 0;
+			const int width = h->word_width[n];
+			hexy_load_word(&h->buf[idx], n, &hi, &lo);
+			assert((used + width) <= HEXY_LINE_BUF_SIZE);
+			hexy_word(&line[used], width, hi, lo, &h->bdiv, h->uppercase_on);
+			used += width;
+		} else if (h->base == 16 && n == 1) {
+			line[used++] = hex[(idx * 2) + 0];
+			line[used++] = hex[(idx * 2) + 1];
+		} else if (h->base == 16) {
+			used = hexy_cat(line, used, &hex[idx * 2], n * 2);
+		} else {
+			used = hexy_cat_digits(h, line, used, &h->buf[idx], n);
+		}
+		idx += n;
+	}
+	used = hexy_cat(line, used, h->sep.eol.b, h->sep.eol.length);
+	assert(used <= HEXY_LINE_BUF_SIZE);
+	return used;
+}
+
+HEXY_API int hexy_format_by_name(const char *name) {
+	assert(name);
+	static const char *names[] = { "hexdump", "c", "json", "plain", "od", };
+	HEXY_BUILD_BUG_ON(HEXY_NELEMS(names) != HEXY_FORMAT_COUNT_E);
+	for (size_t i = 0; i < HEXY_NELEMS(names); i++)
+		if (!strcmp(names[i], name))
+			return i;
+	return HEXY_ELINE;
+}
+
+/* What comes before the first row and after the last one, the declaration
+ * around a C array (with its length, as `xxd -i` does) and, for `od`, the
+ * address one past the end of the input. */
+HEXY_INTERNAL int hexy_format_begin(hexy_t *h) {
 	assert(h);
-	if (h->addresses_off)
+	h->origin = h->address;
+	if (h->format != HEXY_FORMAT_C_E)
 		return 0;
-	if (hexy_aligned_print_number(&h->io, addr, h->abase, 65535, 4, ' ', h->uppercase_on) < 0)
-		return HEXY_ELINE;
-	if (hexy_puts(&h->io, h->sep_adr) < 0)
-		return HEXY_ELINE;
-	return 0;
+	char line[HEXY_MAX_NAME + HEXY_MAX_SEP + 32];
+	size_t used = hexy_cat(line, 0, "unsigned char ", 14);
+	used = hexy_cat(line, used, h->name, strlen(h->name));
+	used = hexy_cat(line, used, "[] = {", 6);
+	used = hexy_cat(line, used, h->sep.eol.b, h->sep.eol.length);
+	return hexy_write(&h->io, line, used);
+}
+
+HEXY_INTERNAL int hexy_format_end(hexy_t *h) {
+	assert(h);
+	char line[HEXY_MAX_NAME + (HEXY_MAX_SEP * 2) + HEXY_PNUM_BUF_SIZE + 64];
+	size_t used = 0;
+	if (h->format == HEXY_FORMAT_C_E) {
+		assert(h->address >= h->origin);
+		used = hexy_cat(line, used, "};", 2);
+		used = hexy_cat(line, used, h->sep.eol.b, h->sep.eol.length);
+		used = hexy_cat(line, used, "unsigned int ", 13);
+		used = hexy_cat(line, used, h->name, strlen(h->name));
+		used = hexy_cat(line, used, "_len = ", 7);
+		used = hexy_cat_decimal(line, used, h->address - h->origin);
+		used = hexy_cat(line, used, ";", 1);
+	} else if (h->format == HEXY_FORMAT_OD_E && !h->addresses_off) {
+		used = hexy_cat_od_address(h, line, used);
+	} else {
+		return 0;
+	}
+	used = hexy_cat(line, used, h->sep.eol.b, h->sep.eol.length);
+	assert(used <= sizeof (line));
+	return hexy_write(&h->io, line, used);
+}
+
+/* Select a renderer for the configuration in `h`, the common layouts
+ * have their own copy with everything but the separators fixed. */
+HEXY_INTERNAL hexy_render_fn hexy_renderer(hexy_t *h) {
+	assert(h);
+	static const hexy_render_fn formats[] = { NULL, hexy_render_c, hexy_render_json, hexy_render_plain, hexy_render_od, };
+	HEXY_BUILD_BUG_ON(HEXY_NELEMS(formats) != HEXY_FORMAT_COUNT_E);
+	assert(h->format >= 0 && h->format < HEXY_FORMAT_COUNT_E);
+	if (h->format != HEXY_FORMAT_HEXDUMP_E)
+		return formats[h->format];
+	static const struct {
+		int base, group, ncols;
+		unsigned flags;
+		hexy_render_fn render;
+	} presets[] = {
+		{ 16, 1, 16, HEXY_ROW_CLASSIC, hexy_render_16_1_16, },
+		{ 16, 2,  8, HEXY_ROW_CLASSIC, hexy_render_16_2_8, },
+		{ 16, 4,  4, HEXY_ROW_CLASSIC, hexy_render_16_4_4, },
+		{ 16, 1, 16, 0,                hexy_render_16_1_16_raw, },
+		{ 16, 1, 16, HEXY_ROW_CLASSIC | HEXY_ROW_COLOR_E, hexy_render_16_1_16_color, },
+	};
+	const unsigned flags = hexy_row_flags(h) & ~(unsigned)HEXY_ROW_REVERSE_E;
+	for (size_t i = 0; i < HEXY_NELEMS(presets); i++)
+		if (presets[i].base == h->base && presets[i].group == h->group && presets[i].ncols == h->ncols && presets[i].flags == flags)
+			return presets[i].render;
+	return hexy_render_row;
 }
 
 HEXY_INTERNAL int hexy_validate(hexy_t *h) {
@@ -553,7 +1822,9 @@ HEXY_INTERNAL int hexy_validate(hexy_t *h) {
 
 	if (h->io.error)
 		return HEXY_ELINE;
-	if (!hexy_is_valid_base(h->base))
+	if (!hexy_is_valid_base(h->base) || !hexy_is_valid_base(h->abase))
+		return HEXY_ELINE;
+	if (h->awidth < 0 || h->awidth > (int)sizeof (h->counter.s))
 		return HEXY_ELINE;
 	if (h->ncols < 1 || h->ncols > HEXY_MAX_NCOLS)
 		return HEXY_ELINE;
@@ -561,39 +1832,117 @@ HEXY_INTERNAL int hexy_validate(hexy_t *h) {
 		return HEXY_ELINE;
 	if (h->group < 1 || h->group > HEXY_MAX_GROUP)
 		return HEXY_ELINE;
+	if (h->format < 0 || h->format >= HEXY_FORMAT_COUNT_E)
+		return HEXY_ELINE;
+	if (!h->name || !h->name[0] || strlen(h->name) > HEXY_MAX_NAME)
+		return HEXY_ELINE;
+	const char *seps[] = { h->sep_adr, h->sep_eol, h->sep_byt, h->sep_ch1, h->sep_ch2, };
+	for (size_t i = 0; i < HEXY_NELEMS(seps); i++)
+		if (!seps[i] || strlen(seps[i]) > HEXY_MAX_SEP)
+			return HEXY_ELINE;
+	return 0;
+}
+
+/* Each byte is printed with the same number of digits, so all 256 of them
+ * are converted once when the base or case changes and copied out of a table
+ * from then on, which avoids a division per digit in the inner loop. The
+ * dividers used for words and addresses are made here as well. */
+HEXY_INTERNAL int hexy_make_digits(hexy_t *h) {
+	assert(h);
+	if (h->bdiv.base != (unsigned)h->base)
+		hexy_divider_make(&h->bdiv, h->base);
+	if (h->adiv.base != (unsigned)h->abase)
+		hexy_divider_make(&h->adiv, h->abase);
+	if (h->digits_base == h->base && h->digits_upper == h->uppercase_on)
+		return 0;
+	const int width = hexy_unsigned_integer_logarithm(255, h->base);
+	assert(width > 0 && width <= 8);
+#ifndef HEXY_NO_DIGIT_TABLE
+	for (int i = 0; i < 256; i++) {
+		char n[HEXY_PNUM_BUF_SIZE + 8] = { 0, };
+		if (hexy_aligned_print_number(n, i, &h->bdiv, 255, width, '0', h->uppercase_on) != width)
+			return HEXY_ELINE;
+		memcpy(h->digits[i], n, width);
+	}
+#endif
+	for (int n = 1; n <= HEXY_MAX_GROUP; n++) { /* digits in the largest word of each size */
+		uint64_t hi = n > 8 ? UINT64_MAX >> (8 * (16 - n)) : 0, lo = n >= 8 ? UINT64_MAX : UINT64_MAX >> (8 * (8 - n));
+		int digits = 0;
+		for (; hi || lo; digits++)
+			(void)hexy_divmod128(&hi, &lo, &h->bdiv);
+		h->word_width[n] = digits;
+	}
+	h->digits_base  = h->base;
+	h->digits_width = width;
+	h->digits_upper = h->uppercase_on;
+	return 0;
+}
+
+/* The separators are copied and unescaped when the configuration is
+ * checked if the `sep_*` pointer differs from the one they were made
+ * from, so `hexy()` and friends do not redo it on every call, and from
+ * then on the row renderer only has to copy them. */
+HEXY_INTERNAL int hexy_make_sep(hexy_sep_t *sep, const char *s) {
+	assert(sep);
+	assert(s);
+	if (sep->from == s)
+		return 0;
+	const size_t length = strlen(s);
+	if (length > HEXY_MAX_SEP)
+		return HEXY_ELINE;
+	sep->from = NULL; /* `b` is not made from anything until this succeeds */
+	memcpy(sep->b, s, length + 1);
+	const int r = hexy_unescape(sep->b, sizeof (sep->b));
+	if (r < 0)
+		return HEXY_ELINE;
+	sep->length = r;
+	sep->from = s;
+	return 0;
+}
+
+HEXY_INTERNAL int hexy_make_seps(hexy_t *h) {
+	assert(h);
+	if (hexy_make_sep(&h->sep.adr, h->sep_adr) < 0)
+		return HEXY_ELINE;
+	if (hexy_make_sep(&h->sep.eol, h->sep_eol) < 0)
+		return HEXY_ELINE;
+	if (hexy_make_sep(&h->sep.byt, h->sep_byt) < 0)
+		return HEXY_ELINE;
+	if (hexy_make_sep(&h->sep.ch1, h->sep_ch1) < 0)
+		return HEXY_ELINE;
+	if (hexy_make_sep(&h->sep.ch2, h->sep_ch2) < 0)
+		return HEXY_ELINE;
 	return 0;
 }
 
 HEXY_INTERNAL int hexy_config_default(hexy_t *h) {
 	assert(h);
-	if (h->init)
-		return hexy_validate(h);
+	if (h->init) {
+		if (hexy_validate(h) < 0)
+			return HEXY_ELINE;
+		if (hexy_make_seps(h) < 0)
+			return HEXY_ELINE;
+		return hexy_make_digits(h);
+	}
 
 	h->base  = h->base  ? h->base  : 16 ;
 	h->ncols = h->ncols ? h->ncols : 16 ;
 	h->abase = h->abase ? h->abase : h->base;
 
-	h->sep_adr = h->sep_adr ? h->sep_adr : HEXY_SEP_ADR;
-	h->sep_eol = h->sep_eol ? h->sep_eol : HEXY_SEP_EOL;
-	h->sep_ch1 = h->sep_ch1 ? h->sep_ch1 : HEXY_SEP_CH1;
-	h->sep_ch2 = h->sep_ch2 ? h->sep_ch2 : HEXY_SEP_CH2 ;
-	h->sep_byt = h->sep_byt ? h->sep_byt : HEXY_SEP_BYT ;
+	h->sep_adr = h->sep_adr ? h->sep_adr : (char*)HEXY_SEP_ADR;
+	h->sep_eol = h->sep_eol ? h->sep_eol : (char*)HEXY_SEP_EOL;
+	h->sep_ch1 = h->sep_ch1 ? h->sep_ch1 : (char*)HEXY_SEP_CH1;
+	h->sep_ch2 = h->sep_ch2 ? h->sep_ch2 : (char*)HEXY_SEP_CH2 ;
+	h->sep_byt = h->sep_byt ? h->sep_byt : (char*)HEXY_SEP_BYT ;
+	h->name    = h->name    ? h->name    : (char*)"data";
 
 	h->group = h->group ? h->group : 1;
 
-	/* // This requires the separator strings to be modifiable, the default strings are not.
-	if (hexy_unescape(h->sep_adr, strlen(h->sep_adr) + 1) < 0)
-		return -1;
-	if (hexy_unescape(h->sep_byt, strlen(h->sep_byt) + 1) < 0)
-		return -1;
-	if (hexy_unescape(h->sep_ch1, strlen(h->sep_ch1) + 1) < 0)
+	if (hexy_validate(h) < 0)
 		return -1;
-	if (hexy_unescape(h->sep_ch2, strlen(h->sep_ch2) + 1) < 0)
+	if (hexy_make_seps(h) < 0)
 		return -1;
-	if (hexy_unescape(h->sep_eol, strlen(h->sep_eol) + 1) < 0)
-		return -1;*/
-
-	if (hexy_validate(h) < 0)
+	if (hexy_make_digits(h) < 0)
 		return -1;
 
 	h->init = true;
@@ -601,222 +1950,1595 @@ HEXY_INTERNAL int hexy_config_default(hexy_t *h) {
 	return 0;
 }
 
-HEXY_API int hexy(hexy_t *h) {
+/* Skip `offset` bytes of input, seeking past them if the input allows
+ * it and reading them into `scratch` otherwise. */
+HEXY_INTERNAL int hexy_skip_io(hexy_io_t *io, uint64_t offset, uint8_t *scratch, size_t length) {
+	assert(io);
+	assert(scratch);
+	assert(length > 0);
+	if (!offset)
+		return 0;
+	const uint64_t start = HEXY_CLOCK(io);
+	const int sought = io->seek ? io->seek(io->in, offset) : -1;
+	HEXY_STAT(io, reads, io->seek != NULL);
+	HEXY_STAT(io, io_time, HEXY_CLOCK(io) - start);
+	if (sought < 0) {
+		for (uint64_t left = offset; left;) {
+			const int got = hexy_read(io, scratch, HEXY_MIN(left, (uint64_t)length));
+			if (got < 0)
+				return HEXY_ELINE;
+			if (got == 0)
+				break;
+			left -= got;
+		}
+	}
+	return 0;
+}
+
+HEXY_INTERNAL int hexy_skip(hexy_t *h) {
 	assert(h);
-	hexy_io_t *io = &h->io;
-	if (hexy_config_default(h) < 0)
+	if (!h->offset)
+		return 0;
+	if ((h->address + h->offset) < h->address) /* overflow */
 		return HEXY_ELINE;
+	if (hexy_skip_io(&h->io, h->offset, h->buf, sizeof (h->buf)) < 0)
+		return HEXY_ELINE;
+	h->address += h->offset;
+	return 0;
+}
 
-	const int byte_align = hexy_unsigned_integer_logarithm(255, h->base);
-	const int length = h->ncols * h->group;
-	assert(length > 0 && length >= h->ncols);
+HEXY_INTERNAL int hexy_emit_row(hexy_t *h, char *line, hexy_render_fn render) {
+	assert(h);
+	assert(line);
+	assert(render);
+	if (h->rev_grp_on) { /* XYZ -> ZYX */
+		/* There is a special case when reversing groups of
+		 * bytes if the last group is incomplete (e.g. we are
+		 * asked to reverse groups of four bytes but a multiple
+		 * of four bytes is not provided).
+		 *
+		 * Currently we do not reverse the last group.
+		 *
+		 * We could optionally reverse last and zero fill missing bytes,
+		 * alternatively an error could be returned, or the
+		 * remaining bytes in the group could be reversed as a
+		 * smaller unit. */
+		const int limit = h->buf_used / h->group; /* skip reversing last group of not evenly divisible */
+		assert((size_t)(limit * h->group) <= sizeof (h->buf));
+		for (int i = 0; i < limit; i++)
+			hexy_reverse_group(&h->buf[i * h->group], h->group);
+	}
+	const uint64_t start = HEXY_CLOCK(&h->io);
+	const int n = render(h, line);
+	HEXY_STAT(&h->io, format_time, HEXY_CLOCK(&h->io) - start);
+	HEXY_STAT(&h->io, rows, 1);
+	HEXY_STAT(&h->io, bytes, h->buf_used);
+	if (n < 0)
+		return HEXY_ELINE;
+	return hexy_write(&h->io, line, n);
+}
 
-	for (int end = 0; !end;) {
-		h->buf_used = 0;
-		for (int i = 0; i < length; i++) {
-			const int ch = hexy_get(io);
-			if (ch < 0)
-				end = 1;
-			if (end && !i)
-				goto done;
-			if (end)
-				break;
-			assert(h->buf_used < sizeof(h->buf));
-			h->buf[h->buf_used++] = ch;
-		}
-		if (hexy_print_address(h, h->address) < 0)
-			return HEXY_ELINE;
-		if (h->rev_grp_on) { /* XYZ -> ZYX */
-			/* There is a special case when reversing groups of
-			 * bytes if the last group is incomplete (e.g. we are
-			 * asked to reverse groups of four bytes but a multiple
-			 * of four bytes is not provided).
-			 *
-			 * Currently we do not reverse the last group.
-			 *
-			 * We could optionally reverse last and zero fill missing bytes,
-			 * alternatively an error could be returned, or the
-			 * remaining bytes in the group could be reversed as a
-			 * smaller unit. */
-			const int limit = h->buf_used / h->group; /* skip reversing last group of not evenly divisible */
-			for (int i = 0; i < limit; i++) {
-				const size_t idx = i * h->group;
-				assert(idx < sizeof (h->buf));
-				hexy_reverse((char*)&h->buf[idx], h->group);
-			}
-		}
+HEXY_INTERNAL bool hexy_squeeze_enabled(hexy_t *h) {
+	assert(h);
+	const bool rows = h->format == HEXY_FORMAT_HEXDUMP_E || h->format == HEXY_FORMAT_OD_E; /* "*" would break the others */
+	return h->squeeze_on && !h->addresses_off && rows;
+}
 
-		for (size_t i = 0; i < (size_t)h->ncols; i++) {
-			for (size_t j = 0; j < (size_t)h->group; j++) {
-				const size_t idx = (i * h->group) + j;
-				assert(idx < sizeof(h->buf));
-				if (idx >= h->buf_used)
-					break;
-				if (hexy_aligned_print_number(io, h->buf[idx], h->base, 255, byte_align, '0', h->uppercase_on) < 0)
-					return HEXY_ELINE;
-			}
-			if (hexy_puts(io, h->sep_byt) < 0)
+/* Returns true if the full row in `h->buf` repeats the previous one and
+ * should not be printed, a "*" line is printed for the first row of each
+ * run of repeats. */
+HEXY_INTERNAL int hexy_squeeze(hexy_t *h) {
+	assert(h);
+	const size_t row = h->ncols * h->group;
+	if (!hexy_squeeze_enabled(h) || h->buf_used != row) {
+		h->prev_on = false;
+		h->squeezing = false;
+		return 0;
+	}
+	if (h->prev_on && !memcmp(h->prev, h->buf, row)) {
+		if (!h->squeezing) {
+			char line[HEXY_MAX_SEP + 1] = { '*', };
+			const size_t eol = h->sep.eol.length;
+			memcpy(&line[1], h->sep.eol.b, eol);
+			if (hexy_write(&h->io, line, eol + 1) < 0)
 				return HEXY_ELINE;
 		}
+		h->squeezing = true;
+		HEXY_STAT(&h->io, squeezed, 1);
+		return 1;
+	}
+	memcpy(h->prev, h->buf, row);
+	h->prev_on = true;
+	h->squeezing = false;
+	return 0;
+}
 
-		if (!h->chars_off) {
-			const int elements = h->ncols * h->group;
-			const int missing = elements - h->buf_used;
-			assert(missing >= 0);
-			assert(missing < 1024);
-			if (hexy_spaces(h, byte_align * missing) < 0)
-				return HEXY_ELINE;
-			if (hexy_puts(io, h->sep_ch1) < 0)
-				return HEXY_ELINE;
-			for (size_t i = 0; i < h->buf_used; i++)
-				if (hexy_print_byte(h, h->buf[i]) < 0)
-					return HEXY_ELINE;
-			if (hexy_spaces(h, missing) < 0)
-				return HEXY_ELINE;
-			if (hexy_puts(io, h->sep_ch2) < 0)
-				return HEXY_ELINE;
-		}
-		if (hexy_newline(h) < 0)
-			return HEXY_ELINE;
-		if ((h->address + h->buf_used) <= h->address) /* overflow */
+/* If the input ended on a run of repeated rows the last row of the run is
+ * printed, so the length of the input can still be seen. */
+HEXY_INTERNAL int hexy_squeeze_end(hexy_t *h, char *line, hexy_render_fn render) {
+	assert(h);
+	const size_t row = h->ncols * h->group;
+	if (!h->squeezing)
+		return 0;
+	h->squeezing = false;
+	h->prev_on = false;
+	assert(h->address >= row);
+	memcpy(h->buf, h->prev, row);
+	h->buf_used = row;
+	h->address -= row;
+	const int r = hexy_emit_row(h, line, render);
+	h->address += row;
+	h->buf_used = 0;
+	return r;
+}
+
+/* The longest row that can be produced with the current configuration,
+ * used to size the buffers rows are rendered into. */
+HEXY_INTERNAL size_t hexy_line_max(hexy_t *h) {
+	assert(h);
+	assert(h->init);
+	const size_t width = h->digits_width, bytes = h->ncols * h->group;
+	size_t r = (bytes * width) + (h->ncols * h->sep.byt.length);
+	if (h->format != HEXY_FORMAT_HEXDUMP_E) /* at most six characters more per byte (", 0x.." or an escape and a character) */
+		r += (bytes * 6) + HEXY_PNUM_BUF_SIZE + 32;
+	if (!h->addresses_off)
+		r += HEXY_PNUM_BUF_SIZE + 4 + h->sep.adr.length;
+	if (!h->chars_off)
+		r += bytes + h->sep.ch1.length + h->sep.ch2.length;
+	if (hexy_row_flags(h) & HEXY_ROW_COLOR_E)
+		r += (bytes + 1) * 2 * HEXY_COLOR_LENGTH;
+	r += h->sep.eol.length;
+	assert(r <= HEXY_LINE_BUF_SIZE);
+	return r;
+}
+
+typedef struct {
+	char *b;                     /* the line, `small` or from `hexy_alloc` */
+	size_t mark;                 /* `arena.used` before `b` was allocated */
+	char small[HEXY_LINE_STACK]; /* used if the longest row fits */
+} hexy_line_t; /* buffer sized for the longest row, see `hexy_line_open` */
+
+/* Get a buffer for rendering rows into, the longest row is usually short
+ * enough for `l->small` and otherwise the buffer comes from `hexy_alloc`,
+ * NULL is returned if that fails. Close it with `hexy_line_close`. */
+HEXY_INTERNAL char *hexy_line_open(hexy_t *h, hexy_line_t *l) {
+	assert(h);
+	assert(l);
+	const size_t n = hexy_line_max(h);
+	l->mark = h->arena.used;
+	l->b = n <= sizeof (l->small) ? l->small : (char*)hexy_alloc(&h->arena, n, false);
+	return l->b;
+}
+
+HEXY_INTERNAL void hexy_line_close(hexy_t *h, hexy_line_t *l) {
+	assert(h);
+	assert(l);
+	if (l->b == l->small)
+		return;
+	hexy_release(&h->arena, l->b);
+	h->arena.used = l->mark;
+}
+
+/* Output the row in `h->buf` unless it is squeezed, and move on to the next. */
+HEXY_INTERNAL int hexy_row(hexy_t *h, char *line, hexy_render_fn render) {
+	assert(h);
+	const int sq = hexy_squeeze(h);
+	if (sq < 0)
+		return HEXY_ELINE;
+	if (!sq && hexy_emit_row(h, line, render) < 0)
+		return HEXY_ELINE;
+	if ((h->address + h->buf_used) <= h->address) { /* overflow */
+		h->io.error = -1;
+		return HEXY_ELINE;
+	}
+	h->address += h->buf_used;
+	h->buf_used = 0;
+	return 0;
+}
+
+HEXY_INTERNAL int hexy_dump_rows(hexy_t *h, bool fresh, bool last, hexy_render_fn render, char *line) {
+	assert(h);
+	assert(h->init);
+	assert(line);
+	hexy_io_t *io = &h->io;
+	const int row = h->ncols * h->group;
+	assert(row > 0 && row >= h->ncols);
+	render = render ? render : hexy_renderer(h);
+	if (hexy_skip(h) < 0)
+		goto fail;
+	if (fresh) {
+		h->prev_on = false;
+		h->squeezing = false;
+		if (hexy_format_begin(h) < 0)
 			goto fail;
-		h->address += h->buf_used;
-		h->buf_used = 0;
+	}
+
+	for (uint64_t left = h->length; ; ) {
+		const int want = h->length ? HEXY_MIN((uint64_t)row, left) : (uint64_t)row;
+		assert((size_t)want <= sizeof(h->buf));
+		const int got = want ? hexy_read(io, h->buf, want) : 0;
+		if (got < 0)
+			return HEXY_ELINE;
+		if (got == 0)
+			goto done;
+		left -= got;
+		h->buf_used = got;
+		if (hexy_row(h, line, render) < 0)
+			return HEXY_ELINE;
+		if (got < row) /* partial row, there is no more input */
+			break;
 	}
 	if (hexy_newline(h) < 0)
 		return HEXY_ELINE;
 done:
+	if (last && hexy_squeeze_end(h, line, render) < 0)
+		return HEXY_ELINE;
+	if (last && hexy_format_end(h) < 0)
+		return HEXY_ELINE;
 	return 0;
 fail:
 	io->error = -1;
 	return HEXY_ELINE;
 }
 
-HEXY_API int hexy_flag(const char *v) {
-	assert(v);
-
-	static char *y[] = { "yes", "on", "true", };
-	static char *n[] = { "no",  "off", "false", };
-
-	for (size_t i = 0; i < HEXY_NELEMS(y); i++) {
-		if (!strcmp(y[i], v))
-			return 1;
-		if (!strcmp(n[i], v))
-			return 0;
+/* Dump input until it runs out, `fresh` starts a new input (so the first
+ * row is not compared when squeezing) and `last` marks the end of it. Rows
+ * are rendered with `render`, or with `hexy_renderer` if it is NULL. */
+HEXY_INTERNAL int hexy_dump(hexy_t *h, bool fresh, bool last, hexy_render_fn render) {
+	assert(h);
+	hexy_line_t l;
+	if (hexy_config_default(h) < 0 || !hexy_line_open(h, &l))
+		return HEXY_ELINE;
+	const int r = hexy_dump_rows(h, fresh, last, render, l.b);
+	hexy_line_close(h, &l);
+	return r;
+}
+
+HEXY_API int hexy(hexy_t *h) {
+	return hexy_dump(h, true, true, NULL);
+}
+
+/* Size `h->awidth` so that the addresses of the next `length` bytes of
+ * input (after the `h->offset` bytes that are skipped) line up, it is the
+ * default width of the last address. This is useful for inputs that go
+ * past 65535 bytes, the default width only lines up before that. */
+HEXY_API int hexy_address_width(hexy_t *h, uint64_t length) {
+	assert(h);
+	if (hexy_config_default(h) < 0)
+		return HEXY_ELINE;
+	length = h->length ? HEXY_MIN(h->length, length) : length;
+	uint64_t last = h->address + h->offset + (length ? length - 1 : 0);
+	if (last < h->address)
+		return HEXY_ELINE;
+	const int digits = hexy_unsigned_integer_logarithm(last, h->abase);
+	const int legacy = hexy_unsigned_integer_logarithm(65535, h->abase);
+	h->awidth = digits + HEXY_MAX(0, HEXY_MIN(legacy - digits, 4));
+	return h->awidth;
+}
+
+/* Give back the row buffer taken by `hexy_begin`, if there is one. */
+HEXY_INTERNAL void hexy_push_release(hexy_t *h) {
+	assert(h);
+	if (!h->line)
+		return;
+	hexy_release(&h->arena, h->line);
+	h->arena.used = h->line_mark;
+	h->line = NULL;
+}
+
+/* The buffer `hexy_feed` and `hexy_finish` render rows into, `small` if
+ * the longest row fits in it, NULL if the configuration has changed
+ * since `hexy_begin` so that it no longer does. */
+HEXY_INTERNAL char *hexy_push_line(hexy_t *h, char small[/*static HEXY_LINE_STACK*/]) {
+	assert(h);
+	assert(small);
+	if (h->line)
+		return h->line;
+	return hexy_line_max(h) <= HEXY_LINE_STACK ? small : NULL;
+}
+
+/* The push interface, instead of pulling input through `h->io` it is given
+ * to `hexy_feed` as it arrives. Only complete rows are output, a partial
+ * row is kept in `h->buf` until more input or `hexy_finish` completes it.
+ * Rows longer than `HEXY_LINE_STACK` are rendered into a buffer that
+ * `hexy_begin` takes from `hexy_alloc` (so with `HEXY_NO_HEAP` the arena
+ * has to have room for it) and `hexy_finish` gives back. Nothing is
+ * allocated by `hexy_feed` and each call does work in proportion to the
+ * amount of input given to it, output still goes through `h->io`. */
+HEXY_API int hexy_begin(hexy_t *h) {
+	assert(h);
+	hexy_push_release(h);
+	if (hexy_config_default(h) < 0)
+		return HEXY_ELINE;
+	if ((h->address + h->offset) < h->address) /* overflow */
+		return HEXY_ELINE;
+	const size_t n = hexy_line_max(h);
+	if (n > HEXY_LINE_STACK) {
+		h->line_mark = h->arena.used;
+		if (!(h->line = (char*)hexy_alloc(&h->arena, n, false)))
+			return HEXY_ELINE;
 	}
-	return -1;
+	h->address += h->offset;
+	h->fed = 0;
+	h->buf_used = 0;
+	h->prev_on = false;
+	h->squeezing = false;
+	const int r = hexy_format_begin(h);
+	if (r < 0)
+		hexy_push_release(h);
+	return r;
 }
 
-HEXY_API int hexy_convert(const char *n, int base, long *out) {
-	assert(n);
-	assert(out);
-	*out = 0;
-	char *endptr = NULL;
-	errno = 0;
-	const long r = strtol(n, &endptr, base);
-	if (*endptr)
-		return -1;
-	if (errno == ERANGE)
-		return -1;
-	*out = r;
+HEXY_API int hexy_feed(hexy_t *h, const uint8_t *data, size_t length) {
+	assert(h);
+	assert(data || !length);
+	if (!h->init || h->io.error)
+		return HEXY_ELINE;
+	const size_t row = h->ncols * h->group;
+	assert(h->buf_used < row);
+	if (h->fed < h->offset) { /* skip, `address` was already advanced by `hexy_begin` */
+		const size_t skip = HEXY_MIN((uint64_t)length, h->offset - h->fed);
+		h->fed += skip;
+		data += skip;
+		length -= skip;
+	}
+	if (h->length)
+		length = HEXY_MIN((uint64_t)length, (h->offset + h->length) - h->fed);
+	h->fed += length;
+	if (!length)
+		return 0;
+	char small[HEXY_LINE_STACK];
+	char *line = hexy_push_line(h, small);
+	if (!line)
+		return HEXY_ELINE;
+	const hexy_render_fn render = hexy_renderer(h);
+	while (length) {
+		const size_t n = HEXY_MIN(length, row - h->buf_used);
+		memcpy(&h->buf[h->buf_used], data, n);
+		h->buf_used += n;
+		data += n;
+		length -= n;
+		if (h->buf_used < row)
+			break;
+		if (hexy_row(h, line, render) < 0)
+			return HEXY_ELINE;
+	}
 	return 0;
 }
 
-HEXY_API int hexy_options_help(hexy_options_t *os, size_t olen, FILE *out) {
-	assert(os);
-	assert(out);
-	for (size_t i = 0; i < olen; i++) {
-		hexy_options_t *o = &os[i];
-		assert(o->opt);
-		const char *type = "unknown";
-		switch (o->type) {
-		case HEXY_OPTIONS_BOOL_E: type = "bool"; break;
-		case HEXY_OPTIONS_LONG_E: type = "long"; break;
-		case HEXY_OPTIONS_STRING_E: type = "string"; break;
-		case HEXY_OPTIONS_INVALID_E: /* fall-through */
-		default: type = "invalid"; break;
+HEXY_API int hexy_finish(hexy_t *h) {
+	assert(h);
+	char small[HEXY_LINE_STACK];
+	char *line = h->init && !h->io.error ? hexy_push_line(h, small) : NULL;
+	if (!line) {
+		hexy_push_release(h);
+		return HEXY_ELINE;
+	}
+	const hexy_render_fn render = hexy_renderer(h);
+	int r = 0;
+	if (h->buf_used && (hexy_row(h, line, render) < 0 || hexy_newline(h) < 0))
+		r = HEXY_ELINE;
+	if (r >= 0 && hexy_squeeze_end(h, line, render) < 0)
+		r = HEXY_ELINE;
+	hexy_push_release(h);
+	return r < 0 ? r : hexy_format_end(h);
+}
+
+HEXY_INTERNAL int hexy_diff_row(hexy_t *h, char *line, hexy_render_fn render, const char *prefix, const uint8_t *b, size_t length) {
+	assert(h);
+	assert(prefix);
+	assert(length <= sizeof (h->buf));
+	if (hexy_write(&h->io, prefix, strlen(prefix)) < 0)
+		return HEXY_ELINE;
+	memcpy(h->buf, b, length);
+	h->buf_used = length;
+	return hexy_emit_row(h, line, render);
+}
+
+/* Print a line of "^" under the bytes of the row last rendered into
+ * `line` (from `b`) that differ from, or are missing in, `a`. The hex and
+ * character views are both marked and tabs in `line` are kept so the marks
+ * line up with it. Words are marked as a whole. */
+HEXY_INTERNAL int hexy_diff_mark(hexy_t *h, const char *line, char *mark, const uint8_t *a, size_t na, const uint8_t *b, size_t nb) {
+	assert(h);
+	assert(line);
+	assert(mark);
+	uint8_t d[sizeof (h->buf)] = { 0, };
+	for (size_t i = 0; i < nb; i++)
+		d[i] = i >= na || a[i] != b[i];
+	if (h->rev_grp_on) /* as `hexy_emit_row` did to the row */
+		for (size_t i = 0; i < (nb / h->group); i++)
+			hexy_reverse_group(&d[i * h->group], h->group);
+	const bool words = h->words_on && !hexy_words_are_bytes(h->base);
+	const size_t width = h->digits_width, byt = h->sep.byt.length, group = h->group;
+	const size_t start = h->addresses_off ? 0 : hexy_render_address(h, mark) + h->sep.adr.length;
+	const size_t column = words ? h->word_width[group] + byt : (group * width) + byt;
+	const size_t chars = start + (h->ncols * column) + h->sep.ch1.length;
+	size_t end = 0;
+	memset(mark, ' ', HEXY_LINE_BUF_SIZE);
+	for (size_t i = 0; i < nb; i++) {
+		if (!d[i])
+			continue;
+		const size_t at = words ? start + ((i / group) * column) : start + ((i / group) * column) + ((i % group) * width);
+		const size_t n = words ? h->word_width[HEXY_MIN(group, nb - ((i / group) * group))] : width;
+		assert((at + n) <= HEXY_LINE_BUF_SIZE);
+		memset(&mark[at], '^', n);
+		end = HEXY_MAX(end, at + n);
+		if (!h->chars_off) {
+			mark[chars + i] = '^';
+			end = HEXY_MAX(end, chars + i + 1);
 		}
-		if (fprintf(out, " * `%s`=%s: %s\n", o->opt, type, o->help ? o->help : "") < 0)
-			return -1;
 	}
+	if (!end) /* only bytes missing from `b` differ */
+		return 0;
+	for (size_t i = 0; i < end; i++)
+		if (line[i] == '\t')
+			mark[i] = '\t';
+	if (hexy_write(&h->io, "  ", 2) < 0 || hexy_write(&h->io, mark, end) < 0)
+		return HEXY_ELINE;
+	return hexy_write(&h->io, h->sep.eol.b, h->sep.eol.length);
+}
+
+/* Add the rows in `b` to the `held` rows of context in `before`, only the
+ * last `context` rows are kept. */
+HEXY_INTERNAL void hexy_diff_keep(uint8_t *before, size_t *held, int context, size_t row, const uint8_t *b, size_t length) {
+	assert(before);
+	assert(held);
+	assert(*held <= (size_t)context);
+	if (!context || !length)
+		return;
+	const size_t rows = (length + row - 1) / row, keep = HEXY_MIN(rows, (size_t)context);
+	const size_t from = (rows - keep) * row, drop = (*held + keep) > (size_t)context ? (*held + keep) - context : 0;
+	memmove(before, &before[drop * row], (*held - drop) * row);
+	*held -= drop;
+	memcpy(&before[*held * row], &b[from], length - from);
+	*held += keep;
+	assert(*held <= (size_t)context);
+}
+
+/* The body of `hexy_diff`, using `a` and `b` to hold `block` bytes of
+ * each input, `before` for `context` rows and `line` and `mark` for
+ * rendering, from a single allocation. */
+HEXY_INTERNAL int hexy_diff_blocks(hexy_t *h, hexy_io_t *other, int context, size_t block, uint8_t *scratch) {
+	assert(h);
+	assert(other);
+	assert(scratch);
+	const size_t row = h->ncols * h->group;
+	uint8_t *a = scratch, *b = &scratch[block], *before = &scratch[block * 2];
+	char *line = (char*)&before[context * row], *mark = &line[HEXY_LINE_BUF_SIZE];
+	const hexy_render_fn render = hexy_renderer(h);
+	size_t held = 0; /* rows of context in `before`, the most recent last */
+	int after = 0, differ = 0;
+	bool printed = false;
+	uint64_t next = h->address; /* address following the last row printed */
+
+	for (uint64_t left = h->length; !h->length || left;) {
+		const size_t want = h->length ? HEXY_MIN((uint64_t)block, left) : block;
+		const int ga = hexy_read(&h->io, a, want), gb = hexy_read(other, b, want);
+		if (ga < 0 || gb < 0)
+			return HEXY_ELINE;
+		if (ga == 0 && gb == 0)
+			break;
+		const size_t most = HEXY_MAX(ga, gb);
+		left -= most;
+		if (ga == gb && !after && !memcmp(a, b, ga)) { /* the common case, only the rows before the next difference are kept */
+			hexy_diff_keep(before, &held, context, row, a, ga);
+			h->address += ga;
+			HEXY_STAT(&h->io, bytes, ga);
+			if ((size_t)ga < want)
+				break;
+			continue;
+		}
+		for (size_t at = 0; at < most; at += row) {
+			const size_t na = (size_t)ga > at ? HEXY_MIN(row, ga - at) : 0, nb = (size_t)gb > at ? HEXY_MIN(row, gb - at) : 0;
+			const uint64_t base = h->address, address = base + at;
+			if (na == nb && !memcmp(&a[at], &b[at], na)) {
+				if (after) {
+					h->address = address;
+					const int r = hexy_diff_row(h, line, render, "  ", &a[at], na);
+					h->address = base;
+					if (r < 0)
+						return HEXY_ELINE;
+					next = address + na;
+					after--;
+				} else {
+					hexy_diff_keep(before, &held, context, row, &a[at], na);
+				}
+				continue;
+			}
+			h->address = address - (held * row);
+			if (context && printed && h->address != next)
+				if (hexy_write(&h->io, "--", 2) < 0 || hexy_write(&h->io, h->sep.eol.b, h->sep.eol.length) < 0)
+					return HEXY_ELINE;
+			for (size_t i = 0; i < held; i++, h->address += row)
+				if (hexy_diff_row(h, line, render, "  ", &before[i * row], row) < 0)
+					return HEXY_ELINE;
+			held = 0;
+			if (na && hexy_diff_row(h, line, render, "< ", &a[at], na) < 0)
+				return HEXY_ELINE;
+			if (nb && hexy_diff_row(h, line, render, "> ", &b[at], nb) < 0)
+				return HEXY_ELINE;
+			if (na && nb && hexy_diff_mark(h, line, mark, &a[at], na, &b[at], nb) < 0)
+				return HEXY_ELINE;
+			h->address = base;
+			next = address + HEXY_MAX(na, nb);
+			printed = true;
+			after = context;
+			differ += differ < INT_MAX;
+		}
+		h->address += most;
+		if (most < want)
+			break;
+	}
+	return differ;
+}
+
+/* Compare the input of `h->io` with that of `other` row by row and dump
+ * only the rows that differ, each as a "< " row from `h->io`, a "> " row
+ * from `other` and a line marking the bytes that differ. Up to `context`
+ * identical rows before and after each run of differences are printed
+ * with a "  " prefix, with "--" between runs that are not adjacent. The
+ * offset and length in `h` apply to both inputs and output goes through
+ * `h->io`. Both inputs are read a block at a time and a block that is the
+ * same in both is skipped with a single `memcmp`, so identical regions cost
+ * little more than reading them. The number of differing rows is returned,
+ * or a negative value on error. Only the hex-dump format can be diffed.
+ * The blocks and a line buffer are taken from `h->arena` if it has room and
+ * from the heap otherwise, with `HEXY_NO_HEAP` the blocks are made smaller
+ * (down to a row) to fit what the arena has left. */
+HEXY_API int hexy_diff(hexy_t *h, hexy_io_t *other, int context) {
+	assert(h);
+	assert(other);
+	if (hexy_config_default(h) < 0)
+		return HEXY_ELINE;
+	if (h->format != HEXY_FORMAT_HEXDUMP_E || !hexy_newlines_enabled(h))
+		return HEXY_ELINE;
+	if (context < 0 || context > HEXY_MAX_CONTEXT)
+		return HEXY_ELINE;
+	const size_t row = h->ncols * h->group, rest = (context * row) + (2 * HEXY_LINE_BUF_SIZE);
+	size_t block = HEXY_MAX(HEXY_DIFF_BLOCK / row, 1) * row;
+#ifdef HEXY_NO_HEAP
+	while (block > row && !hexy_arena_fits(&h->arena, 1, (2 * block) + rest))
+		block = HEXY_MAX(block / (2 * row), 1) * row;
+#endif
+	if (hexy_skip_io(other, h->offset, h->buf, sizeof (h->buf)) < 0 || hexy_skip(h) < 0)
+		return HEXY_ELINE;
+	const size_t mark = h->arena.used;
+	uint8_t *scratch = (uint8_t*)hexy_alloc(&h->arena, (2 * block) + rest, false);
+	if (!scratch)
+		return HEXY_ELINE;
+	const int r = hexy_diff_blocks(h, other, context, block, scratch);
+	hexy_release(&h->arena, scratch);
+	h->arena.used = mark;
+	return r;
+}
+
+/* Prepare `length` bytes of `b` to be searched for, the pattern is copied. */
+HEXY_API int hexy_pattern_make(hexy_pattern_t *p, const uint8_t *b, size_t length) {
+	assert(p);
+	assert(b || !length);
+	if (length < 1 || length > HEXY_MAX_PATTERN)
+		return HEXY_ELINE;
+	memcpy(p->b, b, length);
+	p->length = length;
+	for (size_t i = 0; i < HEXY_NELEMS(p->skip); i++)
+		p->skip[i] = length;
+	for (size_t i = 0; i < (length - 1); i++)
+		p->skip[b[i]] = (length - 1) - i;
 	return 0;
 }
 
-HEXY_API int hexy_options_set(hexy_options_t *os, size_t olen, char *kv, FILE *error) {
-	assert(os);
-	char *k = kv, *v = NULL;
-	if ((v = strchr(kv, '=')) == NULL || *v == '\0') {
-		if (error)
-			(void)fprintf(error, "invalid key-value format: %s\n", kv);
-		return -1;
+/* Make a pattern from a string of hex digits such as "7f454c46", pairs of
+ * digits may be separated by spaces. */
+HEXY_API int hexy_pattern_hex(hexy_pattern_t *p, const char *hex) {
+	assert(p);
+	assert(hex);
+	uint8_t b[HEXY_MAX_PATTERN];
+	size_t length = 0;
+	for (;;) {
+		while (*hex == ' ')
+			hex++;
+		if (!*hex)
+			break;
+		int v = 0;
+		if (length >= sizeof (b) || hexy_hex_str_to_int(hex, &v) != 2)
+			return HEXY_ELINE;
+		b[length++] = v;
+		hex += 2;
 	}
-	*v++ = '\0'; /* Assumes `kv` is writeable! */
+	return hexy_pattern_make(p, b, length);
+}
 
-	hexy_options_t *o = NULL;
-	for (size_t i = 0; i < olen; i++) {
-		hexy_options_t *p = &os[i];
-		if (!strcmp(p->opt, k)) { o = p; break; }
+/* Return the offset of the first match of `p` in the `length` bytes of
+ * `in`, or `length` if there is none. Candidates are found by looking for
+ * the first byte of the pattern with `memchr`, which the C library
+ * vectorizes. If that byte turns out to be common in the input (zeros
+ * usually are) the rest is searched with Boyer-Moore-Horspool instead,
+ * which can skip up to the length of the pattern after each comparison. */
+HEXY_API size_t hexy_pattern_find(const hexy_pattern_t *p, const uint8_t *in, size_t length) {
+	assert(p);
+	assert(in || !length);
+	const size_t n = p->length;
+	assert(n >= 1 && n <= HEXY_MAX_PATTERN);
+	if (n > length)
+		return length;
+	const uint8_t *s = in, *end = &in[(length - n) + 1];
+	for (size_t misses = 0; s < end; s++) {
+		if (!(s = (const uint8_t*)memchr(s, p->b[0], end - s)))
+			return length;
+		if (!memcmp(s, p->b, n))
+			return s - in;
+		if (n >= 4 && ++misses > (64 + ((size_t)(s - in) / 64)))
+			break;
 	}
-	if (!o) {
-		if (error)
-			(void)fprintf(error, "option `%s` not found\n", k);
-		return -1;
+	const uint8_t last = p->b[n - 1];
+	for (size_t i = s - in; i <= (length - n);) {
+		const uint8_t ch = in[i + (n - 1)];
+		if (ch == last && !memcmp(&in[i], p->b, n - 1))
+			return i;
+		i += p->skip[ch];
 	}
+	return length;
+}
 
-	switch (o->type) {
-	case HEXY_OPTIONS_BOOL_E: {
-		const int r = hexy_flag(v);
-		assert(r == 0 || r == 1 || r == -1);
-		if (r < 0) {
-			if (error)
-				(void)fprintf(error, "invalid flag in option `%s`: `%s`\n", k, v);
-			return -1;
+HEXY_INTERNAL int hexy_search_rows(hexy_t *h, char *line, hexy_render_fn render, const uint8_t *win, uint64_t base, uint64_t from, uint64_t to) {
+	assert(h);
+	assert(win);
+	if (from >= to)
+		return 0;
+	assert(from >= base);
+	const size_t row = h->ncols * h->group;
+	for (uint64_t at = from; at < to; at += row) {
+		memcpy(h->buf, &win[at - base], HEXY_MIN(row, to - at));
+		h->buf_used = HEXY_MIN(row, to - at);
+		h->address = at;
+		if (hexy_emit_row(h, line, render) < 0)
+			return HEXY_ELINE;
+	}
+	return 0;
+}
+
+/* The body of `hexy_search`, with a window of `size` bytes followed by a
+ * line buffer in `scratch`, the window holds at least the rows of context
+ * before a match and the rows it spans. */
+HEXY_INTERNAL int hexy_search_window(hexy_t *h, const hexy_pattern_t *p, int context, size_t size, uint8_t *scratch) {
+	assert(h);
+	assert(p);
+	assert(scratch);
+	const uint64_t origin = h->address;
+	const size_t row = h->ncols * h->group, n = p->length, before = context * row;
+	assert(size >= (((context + 3) * row) + n));
+	uint8_t *win = scratch;
+	char *line = (char*)&scratch[size];
+	const hexy_render_fn render = hexy_renderer(h);
+	uint64_t base = origin, /* address of `win[0]`, always at the start of a row */
+		 from = origin, /* next row to print, if it is before `to` */
+		 to = origin,   /* end of the rows to print */
+		 left = h->length;
+	size_t used = 0, scan = 0; /* bytes in `win` and where matches could start that have not been looked for */
+	int matches = 0;
+	bool printed = false, eof = false;
+
+	while (!eof) {
+		const size_t want = h->length ? HEXY_MIN((uint64_t)(size - used), left) : size - used;
+		assert(want > 0 || h->length);
+		const int got = want ? hexy_read(&h->io, &win[used], want) : 0;
+		if (got < 0)
+			return HEXY_ELINE;
+		used += got;
+		left -= got;
+		eof = (size_t)got < want || (h->length && !left);
+		HEXY_STAT(&h->io, bytes, got);
+
+		while (scan + n <= used) {
+			const size_t m = scan + hexy_pattern_find(p, &win[scan], used - scan);
+			if (m + n > used)
+				break;
+			const uint64_t at = base + m, first = at - ((at - origin) % row);
+			const uint64_t start = first - HEXY_MIN(first - origin, (uint64_t)before);
+			const uint64_t end = (at + n - 1) - ((at + n - 1 - origin) % row) + row + before;
+			if (start > to) { /* a new run, the rows of the last one are all in `win` */
+				if (hexy_search_rows(h, line, render, win, base, from, to) < 0)
+					return HEXY_ELINE;
+				if (printed && hexy_write(&h->io, "--", 2) < 0)
+					return HEXY_ELINE;
+				if (printed && hexy_write(&h->io, h->sep.eol.b, h->sep.eol.length) < 0)
+					return HEXY_ELINE;
+				from = start;
+			}
+			to = HEXY_MAX(to, end);
+			printed = true;
+			matches += matches < INT_MAX;
+			scan = m + 1;
 		}
-		*o->v.b = !!r;
-		break;
+		scan = HEXY_MAX(scan, used >= n ? (used - n) + 1 : 0);
+
+		const uint64_t ready = eof ? base + used : base + (used - (used % row)); /* rows that are complete */
+		const uint64_t upto = HEXY_MIN(to, ready);
+		if (from < upto) {
+			if (hexy_search_rows(h, line, render, win, base, from, upto) < 0)
+				return HEXY_ELINE;
+			from = upto;
+		}
+		if (eof)
+			break;
+
+		uint64_t keep = base + scan; /* where the next match could start, and the context before it... */
+		keep -= (keep - origin) % row;
+		keep -= HEXY_MIN(keep - base, (uint64_t)before);
+		keep = from < to ? HEXY_MIN(keep, from) : keep; /* ...and rows still to be printed */
+		const size_t drop = keep - base;
+		assert(drop % row == 0 && drop <= used);
+		memmove(win, &win[drop], used - drop);
+		used -= drop;
+		scan -= drop;
+		base = keep;
 	}
-	case HEXY_OPTIONS_LONG_E: { 
-		const int r = hexy_convert(v, 0, o->v.n); 
-		if (r < 0) {
-			if (error)
-				(void)fprintf(error, "invalid number in option `%s`: `%s`\n", k, v);
+	h->address = base + used;
+	h->buf_used = 0;
+	return matches;
+}
+
+/* Dump only the rows of the input containing a match of `p`, and up to
+ * `context` rows either side of them, with "--" between runs of rows that
+ * are not adjacent. The input is held a block at a time and searched with
+ * `hexy_pattern_find`, matches can span blocks and rows, only the rows that
+ * are printed are formatted. The offset and length in `h` are applied and
+ * rows have their usual addresses. The number of matches is returned, or a
+ * negative value on error. Only the hex-dump format can be searched. The
+ * window and a line buffer are taken from `h->arena` if it has room and
+ * from the heap otherwise, with `HEXY_NO_HEAP` the window is made smaller
+ * (down to what the context and pattern need) to fit the arena. */
+HEXY_API int hexy_search(hexy_t *h, const hexy_pattern_t *p, int context) {
+	assert(h);
+	assert(p);
+	if (hexy_config_default(h) < 0)
+		return HEXY_ELINE;
+	if (h->format != HEXY_FORMAT_HEXDUMP_E || !hexy_newlines_enabled(h))
+		return HEXY_ELINE;
+	if (context < 0 || context > HEXY_MAX_CONTEXT || p->length < 1 || p->length > HEXY_MAX_PATTERN)
+		return HEXY_ELINE;
+	const size_t need = ((context + 3) * h->ncols * h->group) + p->length;
+	size_t size = HEXY_MAX((size_t)HEXY_SEARCH_BLOCK, need);
+#ifdef HEXY_NO_HEAP
+	while (size > need && !hexy_arena_fits(&h->arena, 1, size + HEXY_LINE_BUF_SIZE))
+		size = HEXY_MAX(size / 2, need);
+#endif
+	if (hexy_skip(h) < 0)
+		return HEXY_ELINE;
+	const size_t mark = h->arena.used;
+	uint8_t *scratch = (uint8_t*)hexy_alloc(&h->arena, size + HEXY_LINE_BUF_SIZE, false);
+	if (!scratch)
+		return HEXY_ELINE;
+	const int r = hexy_search_window(h, p, context, size, scratch);
+	hexy_release(&h->arena, scratch);
+	h->arena.used = mark;
+	return r;
+}
+
+#ifdef __cplusplus
+/* A hex-dumper with its layout fixed at compile time, so the row renderer
+ * is instantiated for it with the digit width and loop bounds as constants,
+ * `Flags` is made out of `HEXY_ROW_*` values. The separators, case and base
+ * for addresses can still be changed in `h`, if the layout is changed as
+ * well then the generic renderer is used instead. Usage is:
+ *
+ *	hexy_dumper<16, 1, 16> d(io);
+ *	if (d() < 0) { ... }
+ *
+ * (A `namespace hexy` is not possible as it would clash with `hexy()`.) */
+template <int Base = 16, int Group = 1, int Cols = 16, unsigned Flags = HEXY_ROW_CLASSIC>
+class hexy_dumper {
+	static_assert(Base >= 2 && Base <= 36, "invalid base");
+	static_assert(Group >= 1 && Group <= HEXY_MAX_GROUP, "invalid group");
+	static_assert(Cols >= 1 && Cols <= HEXY_MAX_NCOLS, "invalid number of columns");
+	static_assert(!(Flags & ~(unsigned)(HEXY_ROW_CLASSIC | HEXY_ROW_REVERSE_E | HEXY_ROW_WORDS_E)), "invalid flags");
+	static_assert(!(Flags & (HEXY_ROW_CHARS_E | HEXY_ROW_ADDRESSES_E)) || (Flags & HEXY_ROW_NEWLINES_E), "characters and addresses imply newlines");
+public:
+	hexy_t h;
+
+	explicit hexy_dumper(const hexy_io_t &io) : h() {
+		h.io            = io;
+		h.base          = Base;
+		h.group         = Group;
+		h.ncols         = Cols;
+		h.chars_off     = !(Flags & HEXY_ROW_CHARS_E);
+		h.addresses_off = !(Flags & HEXY_ROW_ADDRESSES_E);
+		h.newlines_off  = !(Flags & HEXY_ROW_NEWLINES_E);
+		h.rev_grp_on    = !!(Flags & HEXY_ROW_REVERSE_E);
+		h.words_on      = !!(Flags & HEXY_ROW_WORDS_E);
+	}
+
+	static int render(hexy_t *h, char *line) {
+		return hexy_render_core(h, line, Base, Group, Cols, Flags & ~(unsigned)HEXY_ROW_REVERSE_E);
+	}
+
+	bool fixed() { /* layout in `h` is still the one given as template arguments */
+		return h.base == Base && h.group == Group && h.ncols == Cols && hexy_row_flags(&h) == Flags && h.format == HEXY_FORMAT_HEXDUMP_E;
+	}
+
+	int operator()() { /* same as `hexy(&h)` */
+		return hexy_dump(&h, true, true, fixed() ? render : NULL);
+	}
+};
+#endif
+
+#define HEXY_DIGIT(X) (\
+	(X) >= '0' && (X) <= '9' ? (X) - '0' :\
+	(X) >= 'a' && (X) <= 'z' ? (X) - 'a' + 10 :\
+	(X) >= 'A' && (X) <= 'Z' ? (X) - 'A' + 10 : 0xff)
+static const uint8_t hexy_digit_table[256] = { HEXY_TABLE(HEXY_DIGIT) }; /* character to digit, 0xff if not one */
+#undef HEXY_DIGIT
+
+typedef struct {
+	hexy_io_t *io;
+	size_t pos, len;  /* position of next character in `b`, and characters in `b` */
+	uint8_t b[1024];  /* must fit the longest token that is matched */
+} hexy_scanner_t;     /* buffered input with look-ahead, used by `hexy_undump` */
+
+typedef struct {
+	hexy_io_t *io;
+	uint64_t at;      /* output position */
+	size_t used;
+	char b[1024];
+} hexy_emitter_t;     /* buffered output, used by `hexy_undump` */
+
+/* Make sure at least `need` characters are buffered, returning how many are */
+HEXY_INTERNAL int hexy_scan_fill(hexy_scanner_t *s, size_t need) {
+	assert(s);
+	assert(need <= sizeof (s->b));
+	if ((s->len - s->pos) >= need)
+		return s->len - s->pos;
+	memmove(s->b, &s->b[s->pos], s->len - s->pos);
+	s->len -= s->pos;
+	s->pos = 0;
+	const int r = hexy_read(s->io, &s->b[s->len], sizeof (s->b) - s->len);
+	if (r < 0)
+		return HEXY_ELINE;
+	s->len += r;
+	return s->len;
+}
+
+HEXY_INTERNAL int hexy_scan_peek(hexy_scanner_t *s) {
+	assert(s);
+	const int r = hexy_scan_fill(s, 1);
+	if (r <= 0)
+		return r < 0 ? r : -1;
+	return s->b[s->pos];
+}
+
+/* Consume `lit` if it is next in the input, returning true if it was */
+HEXY_INTERNAL int hexy_scan_match(hexy_scanner_t *s, const char *lit, size_t length) {
+	assert(s);
+	assert(lit);
+	const int r = hexy_scan_fill(s, length);
+	if (r < 0)
+		return HEXY_ELINE;
+	if ((size_t)r < length || memcmp(&s->b[s->pos], lit, length))
+		return 0;
+	s->pos += length;
+	return 1;
+}
+
+/* Consume input up to and including `eol` (or to the end of input) */
+HEXY_INTERNAL int hexy_scan_line(hexy_scanner_t *s, const char *eol, size_t length) {
+	assert(s);
+	assert(eol);
+	for (;;) {
+		const int r = hexy_scan_match(s, eol, length);
+		if (r != 0)
+			return r < 0 ? r : 0;
+		if (hexy_scan_peek(s) < 0)
+			return 0;
+		s->pos++;
+	}
+}
+
+/* Parse a byte of exactly `width` digits, -1 is returned if there is not one */
+HEXY_INTERNAL int hexy_scan_byte(hexy_scanner_t *s, int base, int width) {
+	assert(s);
+	const int r = hexy_scan_fill(s, width);
+	if (r < width)
+		return r < 0 ? HEXY_ELINE : -1;
+	const uint8_t *d = &s->b[s->pos];
+	int v = 0;
+	if (base == 16 && width == 2) { /* fast path */
+		const int hi = hexy_digit_table[d[0]], lo = hexy_digit_table[d[1]];
+		if ((hi | lo) >= 16)
 			return -1;
+		v = (hi << 4) | lo;
+	} else {
+		for (int i = 0; i < width; i++) {
+			const int n = hexy_digit_table[d[i]];
+			if (n >= base)
+				return -1;
+			v = (v * base) + n;
 		}
-		break; 
+		if (v > 255)
+			return -1;
 	}
-	case HEXY_OPTIONS_STRING_E: { *o->v.s = v; /* Assumes `kv` is persistent! */ break; }
-	default: return -1;
+	s->pos += width;
+	return v;
+}
+
+HEXY_INTERNAL int hexy_emit_flush(hexy_emitter_t *e) {
+	assert(e);
+	const int r = hexy_write(e->io, e->b, e->used);
+	e->used = 0;
+	return r;
+}
+
+HEXY_INTERNAL int hexy_emit(hexy_emitter_t *e, const uint8_t *b, size_t length) {
+	assert(e);
+	assert(b);
+	for (size_t i = 0; i < length; i++) {
+		if (e->used >= sizeof (e->b))
+			if (hexy_emit_flush(e) < 0)
+				return HEXY_ELINE;
+		e->b[e->used++] = b[i];
 	}
-	
+	e->at += length;
 	return 0;
 }
 
-/* Adapted from: <https://stackoverflow.com/questions/10404448>, this
- * could be extended to accept an array of options instead, or
- * perhaps it could be turned into a variadic functions,
- * that is not needed here. The function and structure should be turned
- * into a header only library. 
- *
- * This version handles parsing numbers with '#' and strings with ':'.
- *
- * Return value:
- *
- * - "-1": Finished parsing (end of options or "--" option encountered).
- * - ":": Missing argument (either number or string).
- * - "?": Bad option.
- * - "!": Bad I/O (e.g. `printf` failed).
- * - "#": Bad numeric argument (out of range, not a number, ...)
- *
- * Any other value should correspond to an option.
- *
- */
-HEXY_API int hexy_getopt(hexy_getopt_t *opt, const int argc, char *const argv[], const char *fmt) {
-	assert(opt);
-	assert(fmt);
-	assert(argv);
-	enum { BADARG_E = ':', BADCH_E = '?', BADIO_E = '!', BADNUM_E = '#', OPTEND_E = -1, };
+/* Write out data up to address `addr`, repeating the previous row if it
+ * was squeezed and using zeros otherwise, so holes are rebuilt */
+HEXY_INTERNAL int hexy_emit_until(hexy_emitter_t *e, uint64_t addr, const uint8_t *prev, size_t prev_used, bool squeezed) {
+	assert(e);
+	static const uint8_t zeros[256] = { 0, };
+	if (addr < e->at)
+		return HEXY_ELINE;
+	while (squeezed && prev_used && (e->at + prev_used) <= addr)
+		if (hexy_emit(e, prev, prev_used) < 0)
+			return HEXY_ELINE;
+	while (e->at < addr)
+		if (hexy_emit(e, zeros, HEXY_MIN(addr - e->at, (uint64_t)sizeof (zeros))) < 0)
+			return HEXY_ELINE;
+	return 0;
+}
 
-#define HEXY_GETOPT_NEEDS_ARG(X) ((X) == ':' || (X) == '#')
+/* The reverse of `hexy`, the input is text in the format that `hexy` would
+ * output given the same configuration (base, group, separators, and so
+ * on) which is turned back into binary and written to the output. Rows
+ * are placed at their addresses (if addresses are on), starting from
+ * `h->address`, any gaps between rows are filled in with either the
+ * squeezed row or zeros. The character view is ignored. */
+HEXY_API int hexy_undump(hexy_t *h) {
+	assert(h);
+	if (hexy_config_default(h) < 0)
+		return HEXY_ELINE;
+	if ((hexy_row_flags(h) & (HEXY_ROW_WORDS_E | HEXY_ROW_COLOR_E)) || h->format != HEXY_FORMAT_HEXDUMP_E) /* not supported */
+		return HEXY_ELINE;
+	hexy_scanner_t sc = { .io = &h->io, .pos = 0, }, *s = &sc;
+	hexy_emitter_t em = { .io = &h->io, .at = h->address, }, *e = &em;
+	const bool lines = hexy_newlines_enabled(h);
+	const size_t row = h->ncols * h->group, eol = h->sep.eol.length, byt = h->sep.byt.length, adr = h->sep.adr.length;
+	const int width = h->digits_width;
+	const uint64_t limit = hexy_div(&h->adiv, UINT64_MAX); /* larger addresses overflow if another digit is added */
+	uint8_t cur[sizeof (h->buf)];
+	size_t prev_used = 0;
+	bool squeezed = false;
+	int r = 0;
+
+	for (;;) {
+		if (hexy_scan_peek(s) < 0)
+			break;
+		if (lines && (r = hexy_scan_match(s, h->sep.eol.b, eol)) != 0) { /* blank line */
+			if (r < 0)
+				goto fail;
+			continue;
+		}
+		if (!h->addresses_off) {
+			while (hexy_scan_peek(s) == ' ')
+				s->pos++;
+			if (hexy_scan_peek(s) == '*') {
+				s->pos++;
+				squeezed = true;
+				if (hexy_scan_line(s, h->sep.eol.b, eol) < 0)
+					goto fail;
+				continue;
+			}
+			uint64_t addr = 0;
+			int digits = 0;
+			for (int ch = 0; (ch = hexy_scan_peek(s)) >= 0 && hexy_digit_table[ch] < h->abase; digits++, s->pos++) {
+				if (addr > limit || (addr * h->abase) > (UINT64_MAX - hexy_digit_table[ch])) /* overflow */
+					goto fail;
+				addr = (addr * h->abase) + hexy_digit_table[ch];
+			}
+			if (!digits || hexy_scan_match(s, h->sep.adr.b, adr) != 1)
+				goto fail;
+			if (hexy_emit_until(e, addr, h->prev, prev_used, squeezed) < 0)
+				goto fail;
+		}
+		squeezed = false;
+
+		size_t used = 0;
+		bool partial = false, complete = true;
+		for (int col = 0; col < h->ncols; col++) {
+			int got = 0;
+			for (; !partial && got < h->group; got++) {
+				const int v = hexy_scan_byte(s, h->base, width);
+				if (v < -1)
+					goto fail;
+				if (v < 0)
+					break;
+				cur[used++] = v;
+			}
+			if (got < h->group)
+				partial = true;
+			else if (h->rev_grp_on) /* the partial last group is not reversed */
+				hexy_reverse_group(&cur[used - h->group], h->group);
+			if ((r = hexy_scan_match(s, h->sep.byt.b, byt)) <= 0) {
+				if (r < 0)
+					goto fail;
+				partial = true;
+				complete = false;
+				break;
+			}
+		}
+		if (hexy_emit(e, cur, used) < 0)
+			goto fail;
+		memcpy(h->prev, cur, used);
+		prev_used = used;
+		if (!h->chars_off && complete) { /* skip character view, its length is known, it may contain `sep_eol` */
+			size_t skip = ((row - used) * (width + 1)) + h->sep.ch1.length + used + h->sep.ch2.length;
+			for (; skip && hexy_scan_peek(s) >= 0; skip--)
+				s->pos++;
+		}
+		if (lines) {
+			if (hexy_scan_line(s, h->sep.eol.b, eol) < 0)
+				goto fail;
+		} else if (partial || used < row) {
+			break;
+		}
+	}
+	if (hexy_emit_flush(e) < 0)
+		goto fail;
+	h->address = e->at;
+	return 0;
+fail:
+	h->io.error = -1;
+	return HEXY_ELINE;
+}
+
+/* Dump rows `r0` up to `r1` of the input, which start `ncols * group`
+ * bytes apart from `h->offset`, by moving to the first of them with
+ * `h->io.seek_to`. Rows past `h->length` or the end of the input are not
+ * dumped, `*rows` is set to the number that were and, if `ends` is not
+ * NULL, where the output of each ended relative to that of the first. */
+HEXY_INTERNAL int hexy_rows_dump(hexy_t *h, uint64_t r0, uint64_t r1, size_t *ends, size_t *rows) {
+	assert(h);
+	assert(h->init);
+	assert(h->io.seek_to);
+	assert(rows);
+	const uint64_t row = h->ncols * h->group;
+	r1 = HEXY_MIN(r1, UINT64_MAX / row);
+	uint64_t at = HEXY_MIN(r0, r1) * row, end = r1 * row;
+	if (h->length) {
+		end = HEXY_MIN(end, h->length);
+		at = HEXY_MIN(at, end);
+	}
+	*rows = 0;
+	if (at == end)
+		return 0;
+	if ((h->offset + end) < h->offset || (h->address + h->offset + end) < h->address) /* overflow */
+		return HEXY_ELINE;
+	const uint64_t start = HEXY_CLOCK(&h->io);
+	const int sought = h->io.seek_to(h->io.in, h->offset + at);
+	HEXY_STAT(&h->io, reads, 1);
+	HEXY_STAT(&h->io, io_time, HEXY_CLOCK(&h->io) - start);
+	hexy_line_t l;
+	if (sought < 0 || !hexy_line_open(h, &l))
+		return HEXY_ELINE;
+	const hexy_render_fn render = hexy_renderer(h);
+	const uint64_t address = h->address;
+	const size_t wrote = h->io.wrote;
+	const bool squeeze = h->squeeze_on;
+	h->address += h->offset + at;
+	h->squeeze_on = false; /* every row is wanted, and the row before a window is not known */
+	h->prev_on = false;
+	h->squeezing = false;
+	int r = 0;
+	for (size_t n = 0; at < end; n++) {
+		const int got = hexy_read(&h->io, h->buf, HEXY_MIN(row, end - at));
+		if (got <= 0) {
+			r = got;
+			break;
+		}
+		at += got;
+		h->buf_used = got;
+		if (hexy_row(h, l.b, render) < 0 || ((uint64_t)got < row && hexy_newline(h) < 0)) {
+			r = HEXY_ELINE;
+			break;
+		}
+		if (ends)
+			ends[n] = h->io.wrote - wrote;
+		*rows = n + 1;
+		if ((uint64_t)got < row) /* partial row, there is no more input */
+			break;
+	}
+	hexy_line_close(h, &l);
+	h->address = address;
+	h->squeeze_on = squeeze;
+	return r < 0 ? HEXY_ELINE : 0;
+}
+
+/* Find `block` in `c`, rendering it in place of the least recently used
+ * block if it is not there. The rows are rendered into the block's text
+ * by pointing the output of `h` at it for the duration. */
+HEXY_INTERNAL hexy_cache_block_t *hexy_cache_block(hexy_t *h, hexy_cache_t *c, uint64_t block) {
+	assert(h);
+	assert(c);
+	assert(c->blocks && c->count);
+	hexy_cache_block_t *lru = &c->blocks[0];
+	for (size_t i = 0; i < c->count; i++) {
+		hexy_cache_block_t *b = &c->blocks[i];
+		if (b->used && b->block == block) {
+			b->used = ++c->clock;
+			c->hits++;
+			return b;
+		}
+		lru = b->used < lru->used ? b : lru;
+	}
+	c->misses++;
+	hexy_io_t io = h->io;
+	hexy_buffer_t text = { .b = (uint8_t*)lru->text, .length = c->size, };
+	h->io.out = &text;
+	h->io.put = hexy_buffer_put;
+	h->io.write_block = hexy_buffer_write;
+	lru->used = 0;
+	const uint64_t first = block * HEXY_CACHE_ROWS;
+	const int r = hexy_rows_dump(h, first, first + HEXY_CACHE_ROWS, lru->ends, &lru->rows);
+	io.read = h->io.read;
+	io.error = h->io.error;
+#ifdef HEXY_STATS
+	io.stats = h->io.stats;
+#endif
+	h->io = io;
+	if (r < 0)
+		return NULL;
+	lru->block = block;
+	lru->used = ++c->clock;
+	return lru;
+}
+
+/* Dump rows `r0` up to (but not including) `r1` of a seekable input, for
+ * viewers that show a window onto a large input. `h->io.seek_to` is used
+ * to go straight to the first row so the work done is in proportion to
+ * the size of the window, not to where it is. Rows are `ncols * group`
+ * bytes long, counted from `h->offset` and limited by `h->length`, and are
+ * addressed as `hexy` would address them (`h->address` is left as it is),
+ * rows past the end of the input are not output and no row is squeezed.
+ * Set `h->awidth` (see `hexy_address_width`) for the addresses to line up
+ * as the window moves. Only the hexdump format can be windowed.
+ *
+ * If `c` is not NULL (see `hexy_cache_open`) rows are rendered into it
+ * `HEXY_CACHE_ROWS` at a time and output from there, so moving back and
+ * forth over nearby rows is served from memory. It must be cleared with
+ * `hexy_cache_clear` if the input changes, and opened again if the options
+ * of `h` do. The number of rows output is returned, negative on error. */
+HEXY_API int hexy_rows(hexy_t *h, hexy_cache_t *c, uint64_t r0, uint64_t r1) {
+	assert(h);
+	if (hexy_config_default(h) < 0)
+		return HEXY_ELINE;
+	if (!h->io.seek_to || h->format != HEXY_FORMAT_HEXDUMP_E || h->io.error || r1 < r0 || (r1 - r0) > INT_MAX)
+		return HEXY_ELINE;
+	size_t done = 0;
+	if (!c)
+		return hexy_rows_dump(h, r0, r1, NULL, &done) < 0 ? HEXY_ELINE : (int)done;
+	for (uint64_t at = r0; at < r1;) {
+		const hexy_cache_block_t *b = hexy_cache_block(h, c, at / HEXY_CACHE_ROWS);
+		if (!b)
+			return HEXY_ELINE;
+		const size_t first = at % HEXY_CACHE_ROWS;
+		if (first >= b->rows) /* past the end of the input */
+			break;
+		const size_t last = HEXY_MIN((uint64_t)b->rows, first + (r1 - at));
+		const size_t from = first ? b->ends[first - 1] : 0;
+		if (hexy_write(&h->io, &b->text[from], b->ends[last - 1] - from) < 0)
+			return HEXY_ELINE;
+		done += last - first;
+		at += last - first;
+		if (b->rows < HEXY_CACHE_ROWS)
+			break;
+	}
+	return done;
+}
+
+/* Make a cache of `blocks` blocks of rendered rows for `hexy_rows` to use
+ * with `h`, in its current configuration, the memory is taken from
+ * `h->arena` if it has room and from the heap otherwise (see `hexy_alloc`). */
+HEXY_API int hexy_cache_open(hexy_cache_t *c, hexy_t *h, size_t blocks) {
+	assert(c);
+	assert(h);
+	memset(c, 0, sizeof (*c));
+	if (!blocks || blocks > (SIZE_MAX / sizeof (*c->blocks)) || hexy_config_default(h) < 0)
+		return HEXY_ELINE;
+	c->size = (HEXY_CACHE_ROWS * hexy_line_max(h)) + h->sep.eol.length; /* and the newline after a partial last row */
+	if (!(c->blocks = (hexy_cache_block_t*)hexy_alloc(&h->arena, blocks * sizeof (*c->blocks), true)))
+		return HEXY_ELINE;
+	c->count = blocks;
+	for (size_t i = 0; i < blocks; i++) {
+		if (!(c->blocks[i].text = (char*)hexy_alloc(&h->arena, c->size, false))) {
+			hexy_cache_close(c, h);
+			return HEXY_ELINE;
+		}
+	}
+	return 0;
+}
+
+HEXY_API void hexy_cache_clear(hexy_cache_t *c) {
+	assert(c);
+	for (size_t i = 0; i < c->count; i++)
+		c->blocks[i].used = 0;
+}
+
+HEXY_API void hexy_cache_close(hexy_cache_t *c, hexy_t *h) {
+	assert(c);
+	assert(h);
+	for (size_t i = c->count; c->blocks && i--;)
+		hexy_release(&h->arena, c->blocks[i].text);
+	hexy_release(&h->arena, c->blocks);
+	memset(c, 0, sizeof (*c));
+}
+
+#ifdef HEXY_THREADS
+
+typedef struct {
+	char *b;           /* formatted output for a chunk, `size` bytes long */
+	size_t used, size; /* bytes of `b` used and available */
+	int state;         /* one of the `HEXY_SLOT_*_E` values */
+	hexy_buffer_t arena; /* the rest of the allocation, the worker's `arena` */
+#ifdef HEXY_STATS
+	hexy_stats_t stats; /* formatting statistics for the chunk */
+#endif
+} hexy_slot_t;         /* output buffer for a chunk of input */
+
+enum { HEXY_SLOT_FREE_E, HEXY_SLOT_BUSY_E, HEXY_SLOT_DONE_E, };
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t change;
+	hexy_t *h;           /* configuration to copy, not modified by workers */
+	const uint8_t *data; /* input to format */
+	size_t length,       /* bytes in `data` */
+	       chunk,        /* bytes of input per chunk, a multiple of the row length */
+	       chunks,       /* number of chunks in `data` */
+	       next;         /* next chunk to be claimed by a worker */
+	hexy_slot_t *slots;  /* chunk `n` is formatted into slot `n % nslots` */
+	size_t nslots;
+	int error;           /* set on error, workers stop claiming chunks */
+} hexy_pool_t;           /* work shared between threads by `hexy_parallel` */
+
+HEXY_INTERNAL int hexy_chunk(hexy_pool_t *p, size_t n, hexy_slot_t *s) {
+	assert(p);
+	assert(s);
+	const size_t start = n * p->chunk;
+	hexy_t w = *p->h; /* each worker owns a copy, only `address` differs */
+	hexy_buffer_t in  = { .b = (uint8_t*)&p->data[start], .length = HEXY_MIN(p->chunk, p->length - start), };
+	hexy_buffer_t out = { .b = (uint8_t*)s->b, .length = s->size, };
+	hexy_io_t io = { .get = hexy_buffer_get, .put = hexy_buffer_put, .in = &in, .out = &out, .read_block = hexy_buffer_read, .write_block = hexy_buffer_write, };
+#ifdef HEXY_STATS
+	io.stats.clock = w.io.stats.clock;
+#endif
+	w.io = io;
+	w.arena = s->arena; /* workers must not share `p->h->arena` */
+	w.address += start;
+	const size_t row = w.ncols * w.group;
+	if (start >= row && hexy_squeeze_enabled(&w)) { /* carry on squeezing from the previous chunk */
+		memcpy(w.prev, &p->data[start - row], row);
+		w.prev_on = true;
+		w.squeezing = start >= (row * 2) && !memcmp(&p->data[start - row], &p->data[start - (row * 2)], row);
+	}
+	const int r = hexy_dump(&w, start < row, (n + 1) == p->chunks, NULL);
+	s->used = out.used;
+#ifdef HEXY_STATS
+	s->stats = w.io.stats;
+#endif
+	return r;
+}
+
+HEXY_INTERNAL void *hexy_worker(void *arg) {
+	hexy_pool_t *p = (hexy_pool_t*)arg;
+	assert(p);
+	(void)pthread_mutex_lock(&p->lock);
+	for (;;) {
+		if (p->error || p->next >= p->chunks)
+			break;
+		const size_t n = p->next;
+		hexy_slot_t *s = &p->slots[n % p->nslots];
+		if (s->state != HEXY_SLOT_FREE_E) {
+			(void)pthread_cond_wait(&p->change, &p->lock);
+			continue;
+		}
+		p->next++;
+		s->state = HEXY_SLOT_BUSY_E;
+		(void)pthread_mutex_unlock(&p->lock);
+		const int r = hexy_chunk(p, n, s);
+		(void)pthread_mutex_lock(&p->lock);
+		if (r < 0)
+			p->error = -1;
+		s->state = HEXY_SLOT_DONE_E;
+		(void)pthread_cond_broadcast(&p->change);
+	}
+	(void)pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+#ifdef HEXY_UNIT_TESTS
+static bool hexy_threads_fail; /* pretend threads cannot be started, for the unit tests */
+#endif
+
+HEXY_INTERNAL int hexy_thread_start(pthread_t *id, hexy_pool_t *p) {
+	assert(id);
+	assert(p);
+#ifdef HEXY_UNIT_TESTS
+	if (hexy_threads_fail)
+		return -1;
+#endif
+	return pthread_create(id, NULL, hexy_worker, p) ? -1 : 0;
+}
+
+/* `hexy_parallel` without any threads, `wh` is `h` set up for `data` */
+HEXY_INTERNAL int hexy_parallel_single(hexy_t *h, hexy_t *wh, const uint8_t *data, size_t length) {
+	assert(h);
+	assert(wh);
+	hexy_buffer_t in = { .b = (uint8_t*)data, .length = length, };
+	wh->io.in = &in;
+	wh->io.get = hexy_buffer_get;
+	wh->io.read_block = hexy_buffer_read;
+	const int r = hexy(wh);
+	h->io.read = wh->io.read;
+	h->io.wrote = wh->io.wrote;
+	h->io.error = wh->io.error;
+	h->address = wh->address;
+	return r;
+}
+
+/* Hex-dump `length` bytes of `data` using up to `threads` threads, the
+ * input is split into chunks of `HEXY_CHUNK_ROWS` rows which are formatted
+ * into their own buffers by a pool of workers and written out in order
+ * through `h->io` by the calling thread, the output is the same as
+ * calling `hexy` on the same data. This needs memory for the output of
+ * two chunks per thread, which is taken from `h->arena` if it has room
+ * and from the heap otherwise, with `HEXY_NO_HEAP` fewer threads are used
+ * if the arena is too small (down to none, which needs no memory). */
+HEXY_API int hexy_parallel(hexy_t *h, const uint8_t *data, size_t length, int threads) {
+	assert(h);
+	assert(data);
+	if (hexy_config_default(h) < 0)
+		return HEXY_ELINE;
+	const size_t row = h->ncols * h->group;
+	const size_t skip = HEXY_MIN((uint64_t)length, h->offset); /* input is in memory, `offset` and `length` are applied here */
+	data += skip;
+	length -= skip;
+	length = h->length ? HEXY_MIN((uint64_t)length, h->length) : length;
+	if ((h->address + h->offset) < h->address || (h->address + h->offset + length) < h->address) /* overflow */
+		return HEXY_ELINE;
+	hexy_t wh = *h;
+	hexy_pool_t p = { .h = &wh, .data = data, .length = length, .chunk = row * HEXY_CHUNK_ROWS, };
+	wh.offset = 0;
+	wh.length = 0;
+	wh.address += h->offset;
+	wh.origin = wh.address;
+	p.chunks = (length + p.chunk - 1) / p.chunk;
+	threads = HEXY_MIN(HEXY_MAX(threads, 1), (int)HEXY_MIN(p.chunks, 1024));
+	const size_t size = (HEXY_CHUNK_ROWS * hexy_line_max(h)) + h->sep.eol.length + HEXY_LINE_BUF_SIZE; /* and a header and footer */
+	const size_t line = hexy_line_max(h) + HEXY_ARENA_ALIGN; /* for a worker's `hexy_line_open` */
+#ifdef HEXY_NO_HEAP
+	while (threads > 1 && !hexy_arena_fits(&h->arena, 2 + (threads * 2), (threads * sizeof (pthread_t)) + (threads * 2 * (sizeof (hexy_slot_t) + size + line))))
+		threads--; /* use as many threads as the memory given in `h->arena` allows */
+#endif
+	if (threads <= 1)
+		return hexy_parallel_single(h, &wh, data, length);
+
+	int r = 0, started = 0;
+	const size_t mark = h->arena.used;
+	pthread_t *ids = (pthread_t*)hexy_alloc(&h->arena, threads * sizeof (*ids), true);
+	p.nslots = threads * 2;
+	p.slots = (hexy_slot_t*)hexy_alloc(&h->arena, p.nslots * sizeof (*p.slots), true);
+	if (!ids || !p.slots) {
+		r = HEXY_ELINE;
+		goto done;
+	}
+	for (size_t i = 0; i < p.nslots; i++)
+		if (!(p.slots[i].b = (char*)hexy_alloc(&h->arena, size + line, false))) {
+			r = HEXY_ELINE;
+			goto done;
+		} else {
+			p.slots[i].size = size;
+			p.slots[i].arena.b = (uint8_t*)&p.slots[i].b[size];
+			p.slots[i].arena.length = line;
+		}
+	if (pthread_mutex_init(&p.lock, NULL)) {
+		r = HEXY_ELINE;
+		goto done;
+	}
+	if (pthread_cond_init(&p.change, NULL)) {
+		(void)pthread_mutex_destroy(&p.lock);
+		r = HEXY_ELINE;
+		goto done;
+	}
+	for (; started < threads; started++)
+		if (hexy_thread_start(&ids[started], &p) < 0)
+			break;
+	if (!started) { /* only the consumer frees slots, so dump it all here instead */
+		(void)pthread_cond_destroy(&p.change);
+		(void)pthread_mutex_destroy(&p.lock);
+		r = hexy_parallel_single(h, &wh, data, length);
+		goto done;
+	}
+
+	for (size_t n = 0; n < p.chunks && r >= 0; n++) {
+		hexy_slot_t *s = &p.slots[n % p.nslots];
+		(void)pthread_mutex_lock(&p.lock);
+		while (s->state != HEXY_SLOT_DONE_E && !p.error)
+			(void)pthread_cond_wait(&p.change, &p.lock);
+		const int error = p.error;
+		(void)pthread_mutex_unlock(&p.lock);
+		if (error || hexy_write(&h->io, s->b, s->used) < 0)
+			r = HEXY_ELINE;
+#ifdef HEXY_STATS
+		h->io.stats.rows        += s->stats.rows;
+		h->io.stats.squeezed    += s->stats.squeezed;
+		h->io.stats.bytes       += s->stats.bytes;
+		h->io.stats.format_time += s->stats.format_time;
+#endif
+		(void)pthread_mutex_lock(&p.lock);
+		s->state = HEXY_SLOT_FREE_E;
+		if (r < 0)
+			p.error = -1;
+		(void)pthread_cond_broadcast(&p.change);
+		(void)pthread_mutex_unlock(&p.lock);
+	}
+
+	for (int i = 0; i < started; i++)
+		(void)pthread_join(ids[i], NULL);
+	(void)pthread_cond_destroy(&p.change);
+	(void)pthread_mutex_destroy(&p.lock);
+	if (r >= 0) {
+		h->address += h->offset + length;
+		h->io.read += length;
+	}
+done:
+	if (p.slots)
+		for (size_t i = 0; i < p.nslots; i++)
+			hexy_release(&h->arena, p.slots[i].b);
+	hexy_release(&h->arena, p.slots);
+	hexy_release(&h->arena, ids);
+	h->arena.used = mark;
+	if (r < 0)
+		h->io.error = -1;
+	return r;
+}
+
+#endif /* HEXY_THREADS */
+
+HEXY_API int hexy_flag(const char *v) {
+	assert(v);
+
+	static const char *y[] = { "yes", "on", "true", };
+	static const char *n[] = { "no",  "off", "false", };
+
+	for (size_t i = 0; i < HEXY_NELEMS(y); i++) {
+		if (!strcmp(y[i], v))
+			return 1;
+		if (!strcmp(n[i], v))
+			return 0;
+	}
+	return -1;
+}
+
+HEXY_API int hexy_convert(const char *n, int base, long *out) {
+	assert(n);
+	assert(out);
+	*out = 0;
+	char *endptr = NULL;
+	errno = 0;
+	const long r = strtol(n, &endptr, base);
+	if (*endptr)
+		return -1;
+	if (errno == ERANGE)
+		return -1;
+	*out = r;
+	return 0;
+}
+
+HEXY_API int hexy_options_help(hexy_options_t *os, size_t olen, FILE *out) {
+	assert(os);
+	assert(out);
+	for (size_t i = 0; i < olen; i++) {
+		hexy_options_t *o = &os[i];
+		assert(o->opt);
+		const char *type = "unknown";
+		switch (o->type) {
+		case HEXY_OPTIONS_BOOL_E: type = "bool"; break;
+		case HEXY_OPTIONS_LONG_E: type = "long"; break;
+		case HEXY_OPTIONS_STRING_E: type = "string"; break;
+		case HEXY_OPTIONS_INVALID_E: /* fall-through */
+		default: type = "invalid"; break;
+		}
+		if (fprintf(out, " * `%s`=%s: %s\n", o->opt, type, o->help ? o->help : "") < 0)
+			return -1;
+	}
+	return 0;
+}
+
+HEXY_API int hexy_options_set(hexy_options_t *os, size_t olen, char *kv, FILE *error) {
+	assert(os);
+	char *k = kv, *v = NULL;
+	if ((v = strchr(kv, '=')) == NULL || *v == '\0') {
+		if (error)
+			(void)fprintf(error, "invalid key-value format: %s\n", kv);
+		return -1;
+	}
+	*v++ = '\0'; /* Assumes `kv` is writeable! */
+
+	hexy_options_t *o = NULL;
+	for (size_t i = 0; i < olen; i++) {
+		hexy_options_t *p = &os[i];
+		if (!strcmp(p->opt, k)) { o = p; break; }
+	}
+	if (!o) {
+		if (error)
+			(void)fprintf(error, "option `%s` not found\n", k);
+		return -1;
+	}
+
+	switch (o->type) {
+	case HEXY_OPTIONS_BOOL_E: {
+		const int r = hexy_flag(v);
+		assert(r == 0 || r == 1 || r == -1);
+		if (r < 0) {
+			if (error)
+				(void)fprintf(error, "invalid flag in option `%s`: `%s`\n", k, v);
+			return -1;
+		}
+		*o->v.b = !!r;
+		break;
+	}
+	case HEXY_OPTIONS_LONG_E: { 
+		const int r = hexy_convert(v, 0, o->v.n); 
+		if (r < 0) {
+			if (error)
+				(void)fprintf(error, "invalid number in option `%s`: `%s`\n", k, v);
+			return -1;
+		}
+		break; 
+	}
+	case HEXY_OPTIONS_STRING_E: { *o->v.s = v; /* Assumes `kv` is persistent! */ break; }
+	default: return -1;
+	}
+	
+	return 0;
+}
+
+/* Adapted from: <https://stackoverflow.com/questions/10404448>, this
+ * could be extended to accept an array of options instead, or
+ * perhaps it could be turned into a variadic functions,
+ * that is not needed here. The function and structure should be turned
+ * into a header only library. 
+ *
+ * This version handles parsing numbers with '#' and strings with ':'.
+ *
+ * Return value:
+ *
+ * - "-1": Finished parsing (end of options or "--" option encountered).
+ * - ":": Missing argument (either number or string).
+ * - "?": Bad option.
+ * - "!": Bad I/O (e.g. `printf` failed).
+ * - "#": Bad numeric argument (out of range, not a number, ...)
+ *
+ * Any other value should correspond to an option.
+ *
+ */
+HEXY_API int hexy_getopt(hexy_getopt_t *opt, const int argc, char *const argv[], const char *fmt) {
+	assert(opt);
+	assert(fmt);
+	assert(argv);
+	enum { BADARG_E = ':', BADCH_E = '?', BADIO_E = '!', BADNUM_E = '#', OPTEND_E = -1, };
+
+#define HEXY_GETOPT_NEEDS_ARG(X) ((X) == ':' || (X) == '#')
 
 	if (opt->help) {
 		for (int ch = 0; (ch = *fmt++);) {
@@ -827,116 +3549,1237 @@ HEXY_API int hexy_getopt(hexy_getopt_t *opt, const int argc, char *const argv[],
 					return BADIO_E;
 				fmt++;
 			}
-			if (fputs("\n", opt->help) < 0)
-				return BADIO_E;
+			if (fputs("\n", opt->help) < 0)
+				return BADIO_E;
+		}
+		return OPTEND_E;
+	}
+
+	if (!(opt->init)) {
+		opt->place = (char*)""; /* option letter processing */
+		opt->init  = 1;
+		opt->index = 1;
+	}
+
+	if (opt->reset || !*opt->place) { /* update scanning pointer */
+		opt->reset = 0;
+		if (opt->index >= argc || *(opt->place = argv[opt->index]) != '-') {
+			opt->place = (char*)"";
+			return OPTEND_E;
+		}
+		if (opt->place[1] && *++opt->place == '-') { /* found "--" */
+			opt->index++;
+			opt->place = (char*)"";
+			return OPTEND_E;
+		}
+	}
+
+	const char *oli = NULL; /* option letter list index */
+	opt->option = *opt->place++;
+	if (HEXY_GETOPT_NEEDS_ARG(opt->option) || !(oli = strchr(fmt, opt->option))) { /* option letter okay? */
+		 /* if the user didn't specify '-' as an option, assume it means -1.  */
+		if (opt->option == '-')
+			return OPTEND_E;
+		if (!*opt->place)
+			opt->index++;
+		if (opt->error && !HEXY_GETOPT_NEEDS_ARG(*fmt))
+			if (fprintf(opt->error, "illegal option -- %c\n", opt->option) < 0)
+				return BADIO_E;
+		return BADCH_E;
+	}
+
+	const int o = *++oli;
+	if (!HEXY_GETOPT_NEEDS_ARG(o)) {
+		opt->arg = NULL;
+		if (!*opt->place)
+			opt->index++;
+	} else {  /* need an argument */
+		if (*opt->place) { /* no white space */
+			opt->arg = opt->place;
+			if (o == '#') {
+				if (hexy_convert(opt->arg, 0, &opt->narg) < 0) {
+					if (opt->error)
+						if (fprintf(opt->error, "option requires numeric value -- %s\n", opt->arg) < 0)
+							return BADIO_E;
+					return BADNUM_E;
+				}
+			}
+		} else if (argc <= ++opt->index) { /* no arg */
+			opt->place = (char*)"";
+			if (HEXY_GETOPT_NEEDS_ARG(*fmt)) {
+				return BADARG_E;
+			}
+			if (opt->error)
+				if (fprintf(opt->error, "option requires an argument -- %c\n", opt->option) < 0)
+					return BADIO_E;
+			return BADCH_E;
+		} else	{ /* white space */
+			opt->arg = argv[opt->index];
+			if (o == '#') {
+				if (hexy_convert(opt->arg, 0, &opt->narg) < 0) {
+					if (opt->error)
+						if (fprintf(opt->error, "option requires numeric value -- %s\n", opt->arg) < 0)
+							return BADIO_E;
+					return BADNUM_E;
+				}
+			}
+		}
+		opt->place = (char*)"";
+		opt->index++;
+	}
+#undef HEXY_GETOPT_NEEDS_ARG
+	return opt->option; /* dump back option letter */
+}
+
+#ifdef HEXY_DEFINE_MAIN
+#define HEXY_UNIT_TESTS
+#endif
+
+#ifdef HEXY_UNIT_TESTS
+HEXY_INTERNAL int hexy_test_dump(hexy_t *h, const uint8_t *in, size_t inlen, char *out, size_t outlen, bool blocks) {
+	assert(h);
+	assert(in);
+	assert(out);
+	hexy_buffer_t bi = { .b = (uint8_t*)in, .length = inlen, };
+	hexy_buffer_t bo = { .b = (uint8_t*)out, .length = outlen - 1, };
+	hexy_io_t io = { .get = hexy_buffer_get, .put = hexy_buffer_put, .in = &bi, .out = &bo, };
+	if (blocks) {
+		io.read_block = hexy_buffer_read;
+		io.write_block = hexy_buffer_write;
+		io.seek = hexy_buffer_seek;
+	}
+	h->io = io;
+	if (hexy(h) < 0)
+		return -1;
+	out[bo.used] = '\0';
+	return bo.used;
+}
+
+HEXY_API int hexy_unit_tests(void) {
+	for (size_t i = 0; i < 256; i++) {
+		if (hexy_isupper(hexy_tolower(i)))
+			return -1;
+		if (hexy_islower(hexy_toupper(i)))
+			return -1;
+	}
+
+	{
+		bool b = false;
+		long n = 0;
+		char kv1[] = "flag=on", kv2[] = "number=0x10";
+		hexy_options_t os[] = { /* by position, in the order of the members */
+			{ "flag",   "a flag",   { &b }, HEXY_OPTIONS_BOOL_E, },
+			{ "number", "a number", { 0, }, HEXY_OPTIONS_LONG_E, },
+		};
+		os[1].v.n = &n;
+		if (hexy_options_set(os, HEXY_NELEMS(os), kv1, NULL) < 0 || hexy_options_set(os, HEXY_NELEMS(os), kv2, NULL) < 0)
+			return -1;
+		if (!b || n != 16 || strcmp(os[0].help, "a flag"))
+			return -1;
+	}
+
+	{
+		static char o1[4096], o2[4096];
+		uint8_t in[300] = { 0, };
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = i * 7;
+		hexy_t h1 = { .base = 16, }, h2 = { .base = 16, };
+		const int r1 = hexy_test_dump(&h1, in, sizeof (in), o1, sizeof (o1), false);
+		const int r2 = hexy_test_dump(&h2, in, sizeof (in), o2, sizeof (o2), true);
+		if (r1 <= 0 || r1 != r2 || memcmp(o1, o2, r1))
+			return -1;
+		if (h1.io.read != sizeof (in) || h2.io.read != sizeof (in) || h1.io.wrote != h2.io.wrote)
+			return -1;
+
+		/* the original members of `hexy_io_t` are first, so positional initializers still work */
+		hexy_buffer_t bi = { .b = in, .length = sizeof (in), }, bo = { .b = (uint8_t*)o2, .length = sizeof (o2), };
+		hexy_t h0 = { .io = { hexy_buffer_get, hexy_buffer_put, &bi, &bo, 0, 0, 0, }, .base = 16, };
+		if (hexy(&h0) != 0 || bo.used != (size_t)r1 || memcmp(o1, o2, r1) || h0.io.read_block)
+			return -1;
+
+		hexy_t h3 = { .offset = 21, .length = 40, }, h4 = { .address = 21, };
+		const int r3 = hexy_test_dump(&h3, in, sizeof (in), o1, sizeof (o1), true);
+		const int r4 = hexy_test_dump(&h4, &in[21], 40, o2, sizeof (o2), false);
+		if (r3 <= 0 || r3 != r4 || memcmp(o1, o2, r3) || h3.address != (21 + 40))
+			return -1;
+	}
+
+	{ /* an output error part way through a row sticks, with what was written before it counted */
+		uint8_t in[40] = { 0, };
+		char o[100];
+		for (int blocks = 0; blocks < 2; blocks++) {
+			hexy_t h = { .base = 16, };
+			if (hexy_test_dump(&h, in, sizeof (in), o, 60, blocks) >= 0 || !h.io.error)
+				return -1;
+			if (h.io.wrote != (blocks ? 0 : 59) || hexy(&h) >= 0)
+				return -1;
+		}
+	}
+
+	{ /* windows of rows, with and without a cache, are the same rows as a whole dump */
+		static uint8_t in[1000];
+		static char all[16384], o[16384];
+		static uint8_t mem[32768]; /* room for two blocks of rows in either layout */
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = (i * 7) + (i >> 8);
+		for (int ncols = 4; ncols <= 16; ncols += 12) {
+			hexy_t h1 = { .address = 5, .offset = 3, .length = 990, .ncols = ncols, };
+			const int l1 = hexy_test_dump(&h1, in, sizeof (in), all, sizeof (all), true);
+			if (l1 < 0)
+				return -1;
+			size_t starts[300] = { 0, }, nrows = 0;
+			for (int i = 0; i < l1 && nrows < HEXY_NELEMS(starts) - 1; i++)
+				if (all[i] == '\n')
+					starts[++nrows] = i + 1;
+			const size_t total = (990 + ncols - 1) / ncols; /* a partial last row is followed by an extra newline */
+			if (nrows != total + 1)
+				return -1;
+			starts[total] = l1;
+			const uint64_t windows[][2] = { { 0, 1, }, { 5, 9, }, { 60, 63, }, { 0, 250, }, { 240, 300, }, { 70, 64, }, { 400, 500, }, { 63, 130, }, { 5, 9, }, };
+			hexy_buffer_t bi = { .b = in, .length = sizeof (in), };
+			hexy_io_t io = { .get = hexy_buffer_get, .put = hexy_buffer_put, .in = &bi, .read_block = hexy_buffer_read, .write_block = hexy_buffer_write, .seek_to = hexy_buffer_seek_to, };
+			for (int cached = 0; cached < 3; cached++) {
+				hexy_t h2 = { .io = io, .arena = { .b = cached == 2 ? mem : NULL, .length = sizeof (mem), }, .address = 5, .offset = 3, .length = 990, .ncols = ncols, };
+				hexy_cache_t c = { .blocks = NULL, };
+#ifdef HEXY_NO_HEAP
+				if (cached == 1) { /* without an arena there is no memory for a cache */
+					if (hexy_cache_open(&c, &h2, 2) >= 0)
+						return -1;
+					continue;
+				}
+#endif
+				if (cached && hexy_cache_open(&c, &h2, 2) < 0)
+					return -1;
+				for (size_t i = 0; i < HEXY_NELEMS(windows); i++) {
+					hexy_buffer_t bo = { .b = (uint8_t*)o, .length = sizeof (o), };
+					h2.io.out = &bo;
+					const uint64_t r0 = windows[i][0], r1 = windows[i][1];
+					const int r = hexy_rows(&h2, cached ? &c : NULL, r0, r1);
+					const size_t e0 = HEXY_MIN(r0, total), e1 = r1 < r0 ? e0 : HEXY_MIN(r1, total);
+					if (r1 < r0) {
+						if (r >= 0)
+							return -1;
+						continue;
+					}
+					if (r != (int)(e1 - e0) || bo.used != (starts[e1] - starts[e0]) || memcmp(o, &all[starts[e0]], bo.used))
+						return -1;
+				}
+				if (cached && (c.hits == 0 || c.misses == 0 || (cached == 2 && (uint8_t*)c.blocks[1].text >= &mem[sizeof (mem)])))
+					return -1;
+				hexy_cache_close(&c, &h2);
+			}
+		}
+		hexy_t h = { .ncols = 1, };
+		if (hexy_rows(&h, NULL, 0, 1) >= 0) /* the input must be seekable */
+			return -1;
+	}
+
+	{ /* colour only adds escapes, one per run of a class and a reset per column */
+		const uint8_t in[] = "abc \t\n\0\0\x01\x80\xff\xffxyz!\x7f\x90 a";
+		char o1[2048], o2[2048];
+		for (int base = 8; base <= 16; base += 8) {
+			for (int group = 1; group <= 2; group++) {
+				hexy_t h1 = { .color_on = true, .base = base, .group = group, }, h2 = { .base = base, .group = group, };
+				const int l1 = hexy_test_dump(&h1, in, sizeof (in) - 1, o1, sizeof (o1), true);
+				const int l2 = hexy_test_dump(&h2, in, sizeof (in) - 1, o2, sizeof (o2), true);
+				if (l1 < 0 || l2 < 0)
+					return -1;
+				int l = 0;
+				for (int i = 0; i < l1; i++) {
+					if (o1[i] == '\x1b')
+						while (o1[i] != 'm')
+							i++;
+					else
+						o1[l++] = o1[i];
+				}
+				if (l != l2 || memcmp(o1, o2, l))
+					return -1;
+			}
+		}
+		hexy_t h = { .color_on = true, .base = 16, };
+		if (hexy_test_dump(&h, (const uint8_t*)"aaaa", 4, o1, sizeof (o1), true) < 0)
+			return -1;
+		int escapes = 0;
+		for (size_t i = 0; o1[i]; i++)
+			escapes += o1[i] == '\x1b';
+		if (escapes != 4)
+			return -1;
+	}
+
+	{
+		uint8_t in[256 + 17] = { 0, };
+		char o1[sizeof (in) * 2], o2[sizeof (in) * 2];
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = i < 256 ? i : i * 31;
+		for (size_t off = 0; off < 17; off++) {
+			for (int upper = 0; upper < 2; upper++) {
+				const size_t l = sizeof (in) - off;
+				hexy_hex_encode(&in[off], l, o1, upper);
+				hexy_hex_encode_scalar(&in[off], l, o2, upper);
+				if (memcmp(o1, o2, l * 2))
+					return -1;
+			}
+		}
+	}
+
+	{
+		uint8_t in[256 + 17] = { 0, };
+		char o[sizeof (in)];
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = i < 256 ? i : i * 59;
+		for (size_t off = 0; off < 17; off++) {
+			const size_t l = sizeof (in) - off;
+			hexy_render_chars(&in[off], l, o);
+			for (size_t i = 0; i < l; i++) {
+				const int ch = in[off + i];
+				if (o[i] != (hexy_isgraph(ch) ? ch : HEXY_NON_GRAPHIC_REPLACEMENT_CHAR))
+					return -1;
+			}
+		}
+	}
+
+	{
+		uint8_t in[301], out[sizeof (in)];
+		static char o[8192];
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = i * 37;
+		for (int base = 2; base <= 36; base += 7) {
+			hexy_t h1 = { .rev_grp_on = true, .base = base, .group = 4, }, h2 = h1;
+			const int r = hexy_test_dump(&h1, in, sizeof (in), o, sizeof (o), true);
+			if (r < 0)
+				return -1;
+			hexy_buffer_t bi = { .b = (uint8_t*)o, .length = (size_t)r, }, bo = { .b = out, .length = sizeof (out), };
+			hexy_io_t io = { .get = hexy_buffer_get, .put = hexy_buffer_put, .in = &bi, .out = &bo, };
+			h2.io = io;
+			if (hexy_undump(&h2) < 0 || bo.used != sizeof (in) || memcmp(in, out, sizeof (in)))
+				return -1;
+		}
+	}
+
+	{
+		static const char *expect = 
+			"   0:\t00 00 00 00   |....|\n"
+			"*\n"
+			"  10:\t00 01         |..  |\n\n";
+		uint8_t in[18] = { 0, };
+		char o[256];
+		in[17] = 1;
+		hexy_t h = { .squeeze_on = true, .ncols = 4, };
+		if (hexy_test_dump(&h, in, sizeof (in), o, sizeof (o), true) < 0 || strcmp(o, expect))
+			return -1;
+		static const char *expect_end =
+			"   0:\t00 00 00 00   |....|\n"
+			"*\n"
+			"   c:\t00 00 00 00   |....|\n";
+		h.address = 0;
+		if (hexy_test_dump(&h, in, 16, o, sizeof (o), false) < 0 || strcmp(o, expect_end))
+			return -1;
+#ifdef HEXY_STATS
+		const hexy_stats_t *st = &h.io.stats;
+		if (st->rows != 2 || st->squeezed != 3 || st->bytes != 8 || st->reads != 17 || st->writes != h.io.wrote)
+			return -1;
+#endif
+	}
+
+#ifdef HEXY_THREADS
+	{
+		static uint8_t in[(HEXY_CHUNK_ROWS * 5) + 7]; /* more chunks than two threads have slots for */
+		static char o1[sizeof (in) * 32], o2[sizeof (in) * 32];
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = i * 13;
+		hexy_t h1 = { .address = 3, .ncols = 1, }, h2 = { .address = 3, .ncols = 1, };
+		const int r1 = hexy_test_dump(&h1, in, sizeof (in), o1, sizeof (o1), true);
+		hexy_buffer_t bo = { .b = (uint8_t*)o2, .length = sizeof (o2), };
+		hexy_io_t io = { .put = hexy_buffer_put, .out = &bo, .write_block = hexy_buffer_write, };
+		h2.io = io;
+		if (hexy_parallel(&h2, in, sizeof (in), 3) < 0)
+			return -1;
+		if (r1 <= 0 || (size_t)r1 != bo.used || memcmp(o1, o2, r1) || h1.address != h2.address)
+			return -1;
+		static uint8_t mem[4096]; /* too small for the output buffers, those come from the heap */
+		hexy_t h3 = { .io = io, .arena = { .b = mem, .length = sizeof (mem), }, .address = 3, .ncols = 1, };
+		bo.used = 0;
+		if (hexy_parallel(&h3, in, sizeof (in), 3) < 0 || h3.arena.used != 0)
+			return -1;
+		if ((size_t)r1 != bo.used || memcmp(o1, o2, r1))
+			return -1;
+		hexy_t h4 = { .io = io, .address = 3, .ncols = 1, };
+		bo.used = 0;
+		hexy_threads_fail = true; /* the dump is done on this thread instead */
+		const int r4 = hexy_parallel(&h4, in, sizeof (in), 2);
+		hexy_threads_fail = false;
+		if (r4 < 0 || (size_t)r1 != bo.used || memcmp(o1, o2, r1) || h1.address != h4.address)
+			return -1;
+	}
+#endif
+
+	{
+		static uint8_t mem[256];
+		hexy_buffer_t a = { .b = &mem[1], .length = sizeof (mem) - 1, };
+		uint8_t *p1 = (uint8_t*)hexy_alloc(&a, 100, true), *p2 = (uint8_t*)hexy_alloc(&a, 100, false), *p3 = (uint8_t*)hexy_alloc(&a, 100, false);
+		if (!p1 || !p2 || ((uintptr_t)p1 & (HEXY_ARENA_ALIGN - 1)) || ((uintptr_t)p2 & (HEXY_ARENA_ALIGN - 1)) || p2 < (p1 + 100))
+			return -1;
+		if (p1[0] || p1[99] || (p2 + 100) > &mem[sizeof (mem)] || hexy_arena_fits(&a, 1, 100) || !hexy_arena_fits(&a, 0, sizeof (mem) - a.used - 1))
+			return -1;
+#ifdef HEXY_NO_HEAP
+		if (p3) /* there is no room left */
+			return -1;
+#else
+		if (!p3 || (p3 >= mem && p3 < &mem[sizeof (mem)]))
+			return -1;
+#endif
+		hexy_release(&a, p3);
+		hexy_release(&a, p2);
+		hexy_release(&a, p1);
+	}
+
+	for (int base = 2; base <= 36; base++) {
+		static hexy_t h;
+		h.base = base;
+		h.uppercase_on = base & 1;
+		if (hexy_make_digits(&h) < 0)
+			return -1;
+		for (int i = 0; i < 256; i++) {
+			char n[HEXY_PNUM_BUF_SIZE] = { 0, };
+			if (hexy_unum_to_string(n, i, base, h.uppercase_on) < 0)
+				return -1;
+			const size_t l = strlen(n);
+			char d[8];
+			hexy_byte_digits(&h, d, i, h.digits_width);
+			if (l > (size_t)h.digits_width || memcmp(&d[h.digits_width - l], n, l))
+				return -1;
+		}
+		if (h.digits_width != HEXY_BYTE_WIDTH(base))
+			return -1;
+	}
+
+	{
+		static const struct { int group, ncols; bool raw; } layouts[] = {
+			{ 1, 16, false, }, { 2, 8, false, }, { 4, 4, false, }, { 1, 16, true, },
+		};
+		for (size_t i = 0; i < HEXY_NELEMS(layouts); i++) {
+			hexy_t h = { .address = 0xfff0, .group = layouts[i].group, .ncols = layouts[i].ncols, };
+			h.chars_off = h.addresses_off = h.newlines_off = layouts[i].raw;
+			if (hexy_config_default(&h) < 0)
+				return -1;
+			const hexy_render_fn render = hexy_renderer(&h);
+			if (render == hexy_render_row)
+				return -1;
+			for (size_t used = 0; used <= 16; used++) {
+				char l1[HEXY_LINE_BUF_SIZE], l2[HEXY_LINE_BUF_SIZE];
+				for (size_t j = 0; j < used; j++)
+					h.buf[j] = (j * 71) + used;
+				h.buf_used = used;
+				const int r1 = render(&h, l1), r2 = hexy_render_row(&h, l2);
+				if (r1 <= 0 || r1 != r2 || memcmp(l1, l2, r1))
+					return -1;
+			}
+		}
+	}
+
+	for (int group = 1; group <= HEXY_MAX_GROUP; group++) {
+		uint8_t w1[HEXY_MAX_GROUP], w2[HEXY_MAX_GROUP];
+		for (int i = 0; i < group; i++)
+			w1[i] = w2[i] = i + 1;
+		hexy_reverse((char*)w1, group);
+		hexy_reverse_group(w2, group);
+		if (memcmp(w1, w2, group))
+			return -1;
+	}
+
+	{
+		static const char *expect1 = "    0:\t0016909060 4294967295 \n";
+		static const char *expect2 =
+			"    8:\t340282366920938463463374607431768211455 \n"
+			"   24:\t00256 \n\n";
+		uint8_t in[26] = { 1, 2, 3, 4, };
+		char o1[512], o2[512];
+		memset(&in[4], 0xff, 20);
+		in[24] = 1;
+		hexy_t h = { .chars_off = true, .words_on = true, .base = 10, .group = 4, .ncols = 2, };
+		if (hexy_test_dump(&h, in, 8, o1, sizeof (o1), true) < 0 || strcmp(o1, expect1))
+			return -1;
+#if HEXY_MAX_GROUP >= 16
+		h.group = 16;
+		h.ncols = 1;
+		if (hexy_test_dump(&h, &in[8], 18, o1, sizeof (o1), true) < 0 || strcmp(o1, expect2))
+			return -1;
+#else
+		(void)expect2;
+#endif
+		hexy_t h1 = { .rev_grp_on = true, .words_on = true, .base = 16, .group = 8, }, h2 = h1;
+		h2.words_on = false;
+		if (hexy_test_dump(&h1, in, sizeof (in), o1, sizeof (o1), true) < 0 || hexy_test_dump(&h2, in, sizeof (in), o2, sizeof (o2), true) < 0)
+			return -1;
+		if (strcmp(o1, o2))
+			return -1;
+	}
+
+	for (unsigned base = 2; base <= 36; base++) { /* the dividers against the hardware, at the edges and a spread between */
+		hexy_divider_t d;
+		hexy_divider_make(&d, base);
+		const hexy_divider_t *fixed = base == 8 ? &hexy_divider_8 : base == 10 ? &hexy_divider_10 : &d;
+		if (memcmp(fixed, &d, sizeof (d)))
+			return -1;
+		uint64_t x = 88172645463325252ull;
+		for (int i = 0; i < 2000; i++) {
+			x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+			const uint64_t edges[] = { (uint64_t)i, UINT64_MAX - i, ((UINT64_MAX / base) * base) + (i % 3) - 1, x, x >> (i % 64), };
+			for (size_t j = 0; j < HEXY_NELEMS(edges); j++) {
+				uint64_t n = edges[j];
+				if (hexy_divmod(&d, &n) != edges[j] % base || n != edges[j] / base)
+					return -1;
+				int digits = 0; /* and the digit count, which does not divide */
+				for (uint64_t m = edges[j]; m; m /= base)
+					digits++;
+				if (edges[j] <= (hexy_unum_t)-1 && hexy_unsigned_integer_logarithm(edges[j], base) != HEXY_MAX(digits, 1))
+					return -1;
+			}
+		}
+	}
+
+	{
+		char d[32];
+		const uint64_t n[] = { 0, 9, 10, 99, 1000000007, UINT64_MAX, };
+		const char *expect[] = { "0", "9", "10", "99", "1000000007", "18446744073709551615", };
+		for (size_t i = 0; i < HEXY_NELEMS(n); i++) {
+			const size_t used = hexy_cat_decimal(d, 0, n[i]);
+			if (used != strlen(expect[i]) || memcmp(d, expect[i], used))
+				return -1;
+		}
+	}
+
+	for (int base = 2; base <= 36; base += 5) {
+		hexy_counter_t c = { .at = 0, };
+		hexy_divider_t div;
+		uint64_t at = 0;
+		hexy_divider_make(&div, base);
+		hexy_counter_set(&c, at, &div, base & 1);
+		for (int i = 0; i < 600; i++) {
+			const uint64_t n = i % 7 ? (uint64_t)(i % 33) : (uint64_t)i * i * i * 99991;
+			at += n;
+			hexy_counter_add(&c, n);
+			char d[HEXY_PNUM_BUF_SIZE] = { 0, };
+			if (hexy_unum_to_string(d, at, base, base & 1) < 0)
+				return -1;
+			if (c.at != at || c.length != (int)strlen(d) || memcmp(d, &c.s[sizeof (c.s) - c.length], c.length))
+				return -1;
+		}
+	}
+
+	{
+		uint8_t in[40] = { 0, };
+		char o[1024];
+		hexy_t h = { .address = 65520, .chars_off = true, .ncols = 8, };
+		if (hexy_address_width(&h, sizeof (in)) != 5)
+			return -1;
+		if (hexy_test_dump(&h, in, sizeof (in), o, sizeof (o), true) < 0)
+			return -1;
+		if (strncmp(o, " fff0:", 6) || strncmp(strchr(o, '\n') + 1, " fff8:", 6) || !strstr(o, "\n10000:"))
+			return -1;
+	}
+
+	{
+		uint8_t in[3] = { 'a', 'b', 'c', };
+		char o[64];
+		char byt[] = "\\t", eol[] = "\\x24\\n";
+		hexy_t h = { .sep_eol = eol, .sep_byt = byt, .chars_off = true, .addresses_off = true, };
+		if (hexy_test_dump(&h, in, sizeof (in), o, sizeof (o), true) < 0 || strcmp(o, "61\t62\t63\t" "\t\t\t\t\t\t\t\t\t\t\t\t\t$\n$\n"))
+			return -1;
+		if (strcmp(byt, "\\t")) /* not modified */
+			return -1;
+		if (h.sep.byt.from != byt || h.sep.eol.from != eol)
+			return -1;
+		char dash[] = "-", bad[] = "ab\\";
+		h.sep_byt = dash; /* a new pointer is unescaped again */
+		if (hexy_test_dump(&h, in, sizeof (in), o, sizeof (o), true) < 0 || strncmp(o, "61-62-63-", 9))
+			return -1;
+		h.sep_byt = bad;
+		if (hexy_test_dump(&h, in, sizeof (in), o, sizeof (o), true) >= 0 || h.sep.byt.from)
+			return -1;
+		h.sep_byt = byt; /* and a failed one is not used */
+		if (hexy_test_dump(&h, in, sizeof (in), o, sizeof (o), true) < 0 || strncmp(o, "61\t62\t63\t", 9))
+			return -1;
+	}
+
+	{
+		static uint8_t in[301];
+		static char o1[8192], o2[8192];
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = i < 100 ? 0 : i * 3;
+		for (size_t step = 1; step < 40; step += 6) {
+			const hexy_t c = { .offset = step, .length = step * 7, .squeeze_on = (step & 1) != 0, .group = (int)(step % 3) + 1, .ncols = 4, };
+			hexy_t h1 = c, h2 = c;
+			const int r1 = hexy_test_dump(&h1, in, sizeof (in), o1, sizeof (o1), true);
+			hexy_buffer_t bo = { .b = (uint8_t*)o2, .length = sizeof (o2), };
+			hexy_io_t io = { .put = hexy_buffer_put, .out = &bo, .write_block = hexy_buffer_write, };
+			h2.io = io;
+			if (hexy_begin(&h2) < 0)
+				return -1;
+			for (size_t i = 0; i < sizeof (in); i += step)
+				if (hexy_feed(&h2, &in[i], HEXY_MIN(step, sizeof (in) - i)) < 0)
+					return -1;
+			if (hexy_finish(&h2) < 0)
+				return -1;
+			if (r1 <= 0 || (size_t)r1 != bo.used || memcmp(o1, o2, r1) || h1.address != h2.address)
+				return -1;
+		}
+	}
+
+	{
+		static uint8_t in[1000];
+		static char o1[32768], o2[32768];
+		static uint8_t mem[4096];
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = i * 7;
+		hexy_t h1 = { .arena = { .b = mem, .length = sizeof (mem), }, .base = 2, .group = 8, .ncols = 16, }; /* rows too long for the stack */
+		const int r1 = hexy_test_dump(&h1, in, sizeof (in), o1, sizeof (o1), true);
+		hexy_buffer_t bo = { .b = (uint8_t*)o2, .length = sizeof (o2), };
+		hexy_io_t io = { .put = hexy_buffer_put, .out = &bo, .write_block = hexy_buffer_write, };
+		hexy_t h2 = { .io = io, .arena = { .b = mem, .length = sizeof (mem), }, .base = 2, .group = 8, .ncols = 16, };
+		if (hexy_begin(&h2) < 0 || !h2.line || !h2.arena.used)
+			return -1;
+		const size_t used = h2.arena.used;
+		for (size_t i = 0; i < sizeof (in); i += 77) /* the row buffer is taken once, not by each feed */
+			if (hexy_feed(&h2, &in[i], HEXY_MIN(77, sizeof (in) - i)) < 0 || h2.arena.used != used)
+				return -1;
+		if (hexy_finish(&h2) < 0 || h2.line || h2.arena.used)
+			return -1;
+		if (r1 <= 0 || (size_t)r1 != bo.used || memcmp(o1, o2, r1))
+			return -1;
+	}
+
+	{
+		uint8_t in[5] = { 'a', '"', 0, 'b', 0xff, };
+		char o[512];
+		char name[] = "x";
+		hexy_t c = { .name = name, .ncols = 4, .format = HEXY_FORMAT_C_E, };
+		if (hexy_test_dump(&c, in, sizeof (in), o, sizeof (o), true) < 0)
+			return -1;
+		if (strcmp(o, "unsigned char x[] = {\n\t0x61, 0x22, 0x00, 0x62,\n\t0xff,\n};\nunsigned int x_len = 5;\n"))
+			return -1;
+		hexy_t j = { .address = 16, .ncols = 4, .format = HEXY_FORMAT_JSON_E, };
+		if (hexy_test_dump(&j, in, sizeof (in), o, sizeof (o), true) < 0)
+			return -1;
+		if (strcmp(o, "{\"address\":16,\"bytes\":\"61220062\",\"chars\":\"a\\\".b\"}\n{\"address\":20,\"bytes\":\"ff\",\"chars\":\".\"}\n"))
+			return -1;
+		hexy_t d = { .base = 8, .abase = 8, .ncols = 4, .format = HEXY_FORMAT_OD_E, };
+		if (hexy_test_dump(&d, in, sizeof (in), o, sizeof (o), true) < 0)
+			return -1;
+		if (strcmp(o, "0000000 141 042 000 142\n0000004 377\n0000005\n"))
+			return -1;
+		hexy_t u = { .format = HEXY_FORMAT_PLAIN_E, };
+		if (hexy_test_dump(&u, in, sizeof (in), o, sizeof (o), false) < 0 || strcmp(o, "61220062ff\n"))
+			return -1;
+		if (hexy_format_by_name("od") != HEXY_FORMAT_OD_E || hexy_format_by_name("xxd") >= 0)
+			return -1;
+	}
+
+	{
+		uint8_t x[20] = { 0, }, y[19] = { 0, };
+		char o[1024];
+		y[5] = 1;
+		hexy_buffer_t bo = { .b = (uint8_t*)o, .length = sizeof (o) - 1, }, bx = { .b = x, .length = sizeof (x), }, by = { .b = y, .length = sizeof (y), };
+		hexy_io_t ox = { .in = &bx, .out = &bo, .read_block = hexy_buffer_read, .write_block = hexy_buffer_write, }, oy = { .in = &by, .read_block = hexy_buffer_read, };
+		static uint8_t mem[32768]; /* too small for the default blocks, with `HEXY_NO_HEAP` smaller ones are used */
+		hexy_t h = { .io = ox, .arena = { .b = mem, .length = sizeof (mem), }, .chars_off = true, .ncols = 4, };
+		if (hexy_diff(&h, &oy, 1) != 2 || h.arena.used != 0)
+			return -1;
+		o[bo.used] = '\0';
+		if (strcmp(o, "     0:\t00 00 00 00 \n<    4:\t00 00 00 00 \n>    4:\t00 01 00 00 \n       \t   ^^\n"
+				"     8:\t00 00 00 00 \n     c:\t00 00 00 00 \n<   10:\t00 00 00 00 \n>   10:\t00 00 00  \n"))
+			return -1;
+	}
+
+	{
+		static uint8_t in[3000];
+		hexy_pattern_t p = { .length = 0, };
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = i < 1000 ? 0 : (i * i) >> 3;
+		for (size_t n = 1; n < 12; n++) {
+			for (size_t at = 0; at < sizeof (in); at += 97) {
+				if (hexy_pattern_make(&p, &in[at], HEXY_MIN(n, sizeof (in) - at)) < 0)
+					return -1;
+				size_t naive = 0;
+				while (memcmp(&in[naive], p.b, p.length))
+					naive++;
+				if (hexy_pattern_find(&p, in, sizeof (in)) != naive)
+					return -1;
+			}
+		}
+		if (hexy_pattern_hex(&p, "de ad BEEF") < 0 || p.length != 4 || memcmp(p.b, "\xde\xad\xbe\xef", 4))
+			return -1;
+		if (hexy_pattern_hex(&p, "dea") >= 0 || hexy_pattern_hex(&p, "") >= 0)
+			return -1;
+		if (hexy_pattern_find(&p, in, sizeof (in)) != sizeof (in))
+			return -1;
+	}
+
+	{
+		uint8_t in[40] = { 0, };
+		char o[1024];
+		hexy_pattern_t p = { .length = 0, };
+		in[9] = 1;
+		in[10] = 2;
+		in[35] = 1;
+		in[36] = 2;
+		static uint8_t mem[16384]; /* too small for the default window, with `HEXY_NO_HEAP` a smaller one is used */
+		hexy_t h = { .arena = { .b = mem, .length = sizeof (mem), }, .chars_off = true, .ncols = 4, };
+		hexy_buffer_t bi = { .b = in, .length = sizeof (in), }, bo = { .b = (uint8_t*)o, .length = sizeof (o) - 1, };
+		hexy_io_t io = { .in = &bi, .out = &bo, .read_block = hexy_buffer_read, .write_block = hexy_buffer_write, };
+		h.io = io;
+		if (hexy_pattern_hex(&p, "0102") < 0 || hexy_search(&h, &p, 0) != 2 || h.arena.used != 0)
+			return -1;
+		o[bo.used] = '\0';
+		if (strcmp(o, "   8:\t00 01 02 00 \n--\n  20:\t00 00 00 01 \n  24:\t02 00 00 00 \n"))
+			return -1;
+	}
+
+	{ /* the smallest window finds the same rows as the default one */
+		static uint8_t in[5000], scratch[512 + HEXY_LINE_BUF_SIZE];
+		static char o1[65536], o2[65536];
+		hexy_pattern_t p = { .length = 0, };
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = (i * i) >> 5;
+		if (hexy_pattern_hex(&p, "00 30") < 0)
+			return -1;
+		static uint8_t mem[65536];
+		hexy_t h1 = { .arena = { .b = mem, .length = sizeof (mem), }, .ncols = 8, }, h2 = h1;
+		hexy_buffer_t bi1 = { .b = in, .length = sizeof (in), }, bo1 = { .b = (uint8_t*)o1, .length = sizeof (o1), }, bi2 = bi1, bo2 = { .b = (uint8_t*)o2, .length = sizeof (o2), };
+		hexy_io_t io1 = { .in = &bi1, .out = &bo1, .read_block = hexy_buffer_read, .write_block = hexy_buffer_write, }, io2 = io1;
+		io2.in = &bi2;
+		io2.out = &bo2;
+		h1.io = io1;
+		h2.io = io2;
+		const int r1 = hexy_search(&h1, &p, 2);
+		if (r1 <= 0 || hexy_config_default(&h2) < 0 || hexy_search_window(&h2, &p, 2, (5 * 8) + p.length, scratch) != r1)
+			return -1;
+		if (bo1.used != bo2.used || memcmp(o1, o2, bo1.used) || h1.address != h2.address)
+			return -1;
+	}
+
+#ifdef __cplusplus
+	{
+		uint8_t in[77];
+		char o1[2048], o2[2048];
+		for (size_t i = 0; i < sizeof (in); i++)
+			in[i] = i * 5;
+		hexy_t h = { .group = 2, .ncols = 8, };
+		const int r1 = hexy_test_dump(&h, in, sizeof (in), o1, sizeof (o1), true);
+		hexy_buffer_t bi = { .b = in, .length = sizeof (in), }, bo = { .b = (uint8_t*)o2, .length = sizeof (o2), };
+		hexy_io_t io = { .in = &bi, .out = &bo, .read_block = hexy_buffer_read, .write_block = hexy_buffer_write, };
+		hexy_dumper<16, 2, 8> d(io);
+		if (!d.fixed() || d() < 0 || r1 <= 0 || (size_t)r1 != d.h.io.wrote || memcmp(o1, o2, r1))
+			return -1;
+	}
+#endif
+
+	return 0;
+}
+#else
+HEXY_API int hexy_unit_tests(void) {
+	/* Unit tests turned off, function still available */
+	return 0;
+}
+#endif
+
+#ifdef HEXY_DEFINE_MAIN
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HEXY_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#endif
+#include <time.h>
+
+#if defined(__linux__)
+#define HEXY_FOLLOW
+#include <sys/inotify.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#define HEXY_FOLLOW
+#include <sys/event.h>
+#endif
+
+typedef struct {
+	hexy_buffer_t b; /* view of the mapped file, used with `hexy_buffer_read` */
+	void *map;       /* start of mapping, NULL if not mapped */
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+} hexy_map_t;        /* a regular file mapped into memory */
+
+/* Map in a regular file so it can be used as a buffer, negative is
+ * returned if the file cannot (or should not) be mapped in, in which
+ * case it should be read from with the stdio functions instead. */
+HEXY_INTERNAL int hexy_map(hexy_map_t *m, FILE *f) {
+	assert(m);
+	assert(f);
+	memset(m, 0, sizeof (*m));
+#if defined(HEXY_POSIX)
+	struct stat st;
+	const int fd = fileno(f);
+	if (fd < 0 || fstat(fd, &st) < 0)
+		return HEXY_ELINE;
+	if (!S_ISREG(st.st_mode) || st.st_size <= 0 || (uintmax_t)st.st_size > SIZE_MAX)
+		return HEXY_ELINE;
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return HEXY_ELINE;
+	(void)posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+	m->map = map;
+	m->b.b = (uint8_t*)map;
+	m->b.length = st.st_size;
+	return 0;
+#elif defined(_WIN32)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(f));
+	LARGE_INTEGER size;
+	if (file == INVALID_HANDLE_VALUE || GetFileType(file) != FILE_TYPE_DISK)
+		return HEXY_ELINE;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || (uint64_t)size.QuadPart > SIZE_MAX)
+		return HEXY_ELINE;
+	HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+		return HEXY_ELINE;
+	void *map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!map) {
+		(void)CloseHandle(mapping);
+		return HEXY_ELINE;
+	}
+	m->mapping = mapping;
+	m->map = map;
+	m->b.b = (uint8_t*)map;
+	m->b.length = size.QuadPart;
+	return 0;
+#else
+	return HEXY_ELINE;
+#endif
+}
+
+HEXY_INTERNAL int hexy_file_size(FILE *f, uint64_t *size) { /* size of `f` if it is a regular file */
+	assert(f);
+	assert(size);
+	*size = 0;
+#if defined(HEXY_POSIX)
+	struct stat st;
+	const int fd = fileno(f);
+	if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < 0)
+		return HEXY_ELINE;
+	*size = st.st_size;
+	return 0;
+#elif defined(_WIN32)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(f));
+	LARGE_INTEGER length;
+	if (file == INVALID_HANDLE_VALUE || GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &length) || length.QuadPart < 0)
+		return HEXY_ELINE;
+	*size = length.QuadPart;
+	return 0;
+#else
+	return HEXY_ELINE;
+#endif
+}
+
+HEXY_INTERNAL int hexy_unmap(hexy_map_t *m) {
+	assert(m);
+	if (!m->map)
+		return 0;
+	int r = 0;
+#if defined(HEXY_POSIX)
+	r = munmap(m->map, m->b.length) < 0 ? HEXY_ELINE : 0;
+#elif defined(_WIN32)
+	r = UnmapViewOfFile(m->map) && CloseHandle(m->mapping) ? 0 : HEXY_ELINE;
+#endif
+	m->map = NULL;
+	return r;
+}
+
+#ifndef HEXY_SINK_DEFAULT
+#define HEXY_SINK_DEFAULT (1024l * 1024l) /* default size of the output buffer */
+#endif
+
+#ifndef HEXY_SINK_ALIGN
+#define HEXY_SINK_ALIGN (4096) /* alignment of the output buffer, a page on most systems */
+#endif
+
+typedef struct {
+	char *b;           /* output buffer, `size` bytes long */
+	size_t used, size; /* bytes of `b` in use and available */
+	FILE *file;        /* written to directly if `fd` is negative */
+	int fd;            /* file descriptor written to with `write` and `writev` */
+} hexy_sink_t;         /* collects output so it is written in large blocks */
+
+HEXY_INTERNAL int hexy_sink_open(hexy_sink_t *s, FILE *file, size_t size) {
+	assert(s);
+	assert(file);
+	memset(s, 0, sizeof (*s));
+	s->file = file;
+	s->fd = -1;
+	s->size = size;
+#if defined(HEXY_POSIX)
+	s->fd = fileno(file);
+	void *b = NULL;
+	if (posix_memalign(&b, HEXY_SINK_ALIGN, size))
+		return HEXY_ELINE;
+	s->b = (char*)b;
+#else
+	s->b = (char*)malloc(size);
+#endif
+	return s->b ? 0 : HEXY_ELINE;
+}
+
+/* Write out `a` and then `b`, with a single system call if possible */
+HEXY_INTERNAL int hexy_sink_out(hexy_sink_t *s, const char *a, size_t alen, const char *b, size_t blen) {
+	assert(s);
+#if defined(HEXY_POSIX)
+	if (s->fd >= 0) {
+		struct iovec v[2] = { { .iov_base = (void*)a, .iov_len = alen, }, { .iov_base = (void*)b, .iov_len = blen, }, };
+		for (int i = 0; i < 2;) {
+			if (!v[i].iov_len) {
+				i++;
+				continue;
+			}
+			errno = 0;
+			const ssize_t r = writev(s->fd, &v[i], 2 - i);
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r <= 0)
+				return HEXY_ELINE;
+			for (size_t n = r; n;) { /* partial writes are possible, especially to pipes */
+				const size_t step = HEXY_MIN(n, v[i].iov_len);
+				v[i].iov_base = (char*)v[i].iov_base + step;
+				v[i].iov_len -= step;
+				n -= step;
+				i += !v[i].iov_len;
+			}
 		}
-		return OPTEND_E;
+		return 0;
 	}
+#endif
+	if (alen && fwrite(a, 1, alen, s->file) != alen)
+		return HEXY_ELINE;
+	if (blen && fwrite(b, 1, blen, s->file) != blen)
+		return HEXY_ELINE;
+	return 0;
+}
 
-	if (!(opt->init)) {
-		opt->place = ""; /* option letter processing */
-		opt->init  = 1;
-		opt->index = 1;
+HEXY_INTERNAL int hexy_sink_flush(hexy_sink_t *s) {
+	assert(s);
+	const size_t used = s->used;
+	s->used = 0;
+	if (hexy_sink_out(s, s->b, used, NULL, 0) < 0)
+		return HEXY_ELINE;
+	return s->fd < 0 && fflush(s->file) < 0 ? HEXY_ELINE : 0;
+}
+
+HEXY_INTERNAL int hexy_sink_close(hexy_sink_t *s) {
+	assert(s);
+	const int r = s->b ? hexy_sink_flush(s) : 0;
+	free(s->b);
+	s->b = NULL;
+	return r;
+}
+
+HEXY_INTERNAL int hexy_sink_write(void *out, const char *buf, size_t length) {
+	hexy_sink_t *s = (hexy_sink_t*)out;
+	assert(s);
+	assert(buf);
+	if (length <= (s->size - s->used)) {
+		memcpy(&s->b[s->used], buf, length);
+		s->used += length;
+		return length;
+	}
+	const size_t used = s->used;
+	s->used = 0;
+	if (length >= s->size) { /* too big to buffer, write it out along with the buffer */
+		if (hexy_sink_out(s, s->b, used, buf, length) < 0)
+			return HEXY_ELINE;
+		return length;
 	}
+	if (hexy_sink_out(s, s->b, used, NULL, 0) < 0)
+		return HEXY_ELINE;
+	memcpy(s->b, buf, length);
+	s->used = length;
+	return length;
+}
 
-	if (opt->reset || !*opt->place) { /* update scanning pointer */
-		opt->reset = 0;
-		if (opt->index >= argc || *(opt->place = argv[opt->index]) != '-') {
-			opt->place = "";
-			return OPTEND_E;
-		}
-		if (opt->place[1] && *++opt->place == '-') { /* found "--" */
-			opt->index++;
-			opt->place = "";
-			return OPTEND_E;
+HEXY_INTERNAL int hexy_sink_put(void *out, int ch) {
+	hexy_sink_t *s = (hexy_sink_t*)out;
+	assert(s);
+	const char c = ch;
+	return hexy_sink_write(s, &c, 1) == 1 ? (uint8_t)ch : HEXY_ELINE;
+}
+
+#ifdef HEXY_THREADS
+#ifndef HEXY_ASYNC_BUFFERS
+#define HEXY_ASYNC_BUFFERS (4) /* number of buffers the reader thread can fill ahead of the formatter */
+#endif
+
+#ifndef HEXY_ASYNC_SIZE
+#define HEXY_ASYNC_SIZE (256 * 1024) /* size of each read ahead buffer */
+#endif
+
+/* A reader thread keeps up to `HEXY_ASYNC_BUFFERS` reads in flight ahead of
+ * the formatter, so waiting on a slow device overlaps with formatting. The
+ * buffers form a ring, the reader fills `head` and the formatter drains
+ * `tail`, the lock is only taken when moving between buffers. */
+typedef struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t change;
+	uint8_t *b[HEXY_ASYNC_BUFFERS]; /* read ahead buffers, `HEXY_ASYNC_SIZE` bytes each */
+	size_t got[HEXY_ASYNC_BUFFERS]; /* bytes read into each buffer */
+	size_t head, tail, pos;         /* next buffer to fill, next to drain, position in buffer `tail` */
+	int fd;                         /* file descriptor read from */
+	bool started, eof, stop, error;
+} hexy_async_t;
+
+HEXY_INTERNAL int hexy_async_open(hexy_async_t *a, FILE *f) {
+	assert(a);
+	assert(f);
+	memset(a, 0, sizeof (*a));
+	a->fd = fileno(f);
+	if (a->fd < 0)
+		return HEXY_ELINE;
+	for (size_t i = 0; i < HEXY_NELEMS(a->b); i++)
+		if (!(a->b[i] = (uint8_t*)malloc(HEXY_ASYNC_SIZE)))
+			goto fail;
+	if (pthread_mutex_init(&a->lock, NULL))
+		goto fail;
+	if (pthread_cond_init(&a->change, NULL)) {
+		(void)pthread_mutex_destroy(&a->lock);
+		goto fail;
+	}
+	return 0;
+fail:
+	for (size_t i = 0; i < HEXY_NELEMS(a->b); i++)
+		free(a->b[i]);
+	return HEXY_ELINE;
+}
+
+HEXY_INTERNAL void *hexy_async_reader(void *arg) {
+	hexy_async_t *a = (hexy_async_t*)arg;
+	assert(a);
+	int state = 0; /* only a blocked `read` can be cancelled, see `hexy_async_close` */
+	(void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+	(void)pthread_mutex_lock(&a->lock);
+	while (!a->stop) {
+		if ((a->head - a->tail) == HEXY_NELEMS(a->b)) {
+			(void)pthread_cond_wait(&a->change, &a->lock);
+			continue;
 		}
+		const size_t n = a->head % HEXY_NELEMS(a->b);
+		(void)pthread_mutex_unlock(&a->lock);
+		ssize_t r = 0;
+		(void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &state);
+		do {
+			errno = 0;
+			r = read(a->fd, a->b[n], HEXY_ASYNC_SIZE);
+		} while (r < 0 && errno == EINTR);
+		(void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+		(void)pthread_mutex_lock(&a->lock);
+		a->got[n] = r > 0 ? r : 0;
+		a->head += r > 0;
+		a->eof = r <= 0;
+		a->error = r < 0;
+		(void)pthread_cond_broadcast(&a->change);
+		if (r <= 0)
+			break;
 	}
+	(void)pthread_mutex_unlock(&a->lock);
+	return NULL;
+}
 
-	const char *oli = NULL; /* option letter list index */
-	opt->option = *opt->place++;
-	if (HEXY_GETOPT_NEEDS_ARG(opt->option) || !(oli = strchr(fmt, opt->option))) { /* option letter okay? */
-		 /* if the user didn't specify '-' as an option, assume it means -1.  */
-		if (opt->option == '-')
-			return OPTEND_E;
-		if (!*opt->place)
-			opt->index++;
-		if (opt->error && !HEXY_GETOPT_NEEDS_ARG(*fmt))
-			if (fprintf(opt->error, "illegal option -- %c\n", opt->option) < 0)
-				return BADIO_E;
-		return BADCH_E;
+HEXY_INTERNAL int hexy_async_read(void *in, uint8_t *buf, size_t length) {
+	hexy_async_t *a = (hexy_async_t*)in;
+	assert(a);
+	assert(buf);
+	if (!a->started) {
+		if (pthread_create(&a->thread, NULL, hexy_async_reader, a))
+			return HEXY_ELINE;
+		a->started = true;
+	}
+	const size_t n = a->tail % HEXY_NELEMS(a->b);
+	if (a->pos == 0) { /* wait for the buffer to be filled */
+		(void)pthread_mutex_lock(&a->lock);
+		while (a->head == a->tail && !a->eof)
+			(void)pthread_cond_wait(&a->change, &a->lock);
+		const bool empty = a->head == a->tail, error = a->error;
+		(void)pthread_mutex_unlock(&a->lock);
+		if (empty)
+			return error ? HEXY_ELINE : 0;
+	}
+	const size_t copy = HEXY_MIN(length, a->got[n] - a->pos);
+	memcpy(buf, &a->b[n][a->pos], copy);
+	a->pos += copy;
+	if (a->pos == a->got[n]) { /* hand the buffer back to the reader */
+		(void)pthread_mutex_lock(&a->lock);
+		a->tail++;
+		a->pos = 0;
+		(void)pthread_cond_broadcast(&a->change);
+		(void)pthread_mutex_unlock(&a->lock);
 	}
+	return copy;
+}
 
-	const int o = *++oli;
-	if (!HEXY_GETOPT_NEEDS_ARG(o)) {
-		opt->arg = NULL;
-		if (!*opt->place)
-			opt->index++;
-	} else {  /* need an argument */
-		if (*opt->place) { /* no white space */
-			opt->arg = opt->place;
-			if (o == '#') {
-				if (hexy_convert(opt->arg, 0, &opt->narg) < 0) {
-					if (opt->error)
-						if (fprintf(opt->error, "option requires numeric value -- %s\n", opt->arg) < 0)
-							return BADIO_E;
-					return BADNUM_E;
-				}
-			}
-		} else if (argc <= ++opt->index) { /* no arg */
-			opt->place = "";
-			if (HEXY_GETOPT_NEEDS_ARG(*fmt)) {
-				return BADARG_E;
-			}
-			if (opt->error)
-				if (fprintf(opt->error, "option requires an argument -- %c\n", opt->option) < 0)
-					return BADIO_E;
-			return BADCH_E;
-		} else	{ /* white space */
-			opt->arg = argv[opt->index];
-			if (o == '#') {
-				if (hexy_convert(opt->arg, 0, &opt->narg) < 0) {
-					if (opt->error)
-						if (fprintf(opt->error, "option requires numeric value -- %s\n", opt->arg) < 0)
-							return BADIO_E;
-					return BADNUM_E;
-				}
-			}
-		}
-		opt->place = "";
-		opt->index++;
+HEXY_INTERNAL int hexy_async_get(void *in) {
+	uint8_t b = 0;
+	const int r = hexy_async_read(in, &b, 1);
+	return r <= 0 ? -1 : b;
+}
+
+HEXY_INTERNAL int hexy_async_seek(void *in, uint64_t offset) {
+	hexy_async_t *a = (hexy_async_t*)in;
+	assert(a);
+	if (a->started || offset > INT64_MAX) /* data has been read ahead, it must be read instead */
+		return HEXY_ELINE;
+	return lseek(a->fd, offset, SEEK_CUR) < 0 ? HEXY_ELINE : 0;
+}
+
+HEXY_INTERNAL void hexy_async_close(hexy_async_t *a) {
+	assert(a);
+	if (a->started) {
+		(void)pthread_mutex_lock(&a->lock);
+		a->stop = true;
+		(void)pthread_cond_broadcast(&a->change);
+		(void)pthread_mutex_unlock(&a->lock);
+		(void)pthread_cancel(a->thread); /* it may be blocked reading input that is no longer needed */
+		(void)pthread_join(a->thread, NULL);
 	}
-#undef HEXY_GETOPT_NEEDS_ARG
-	return opt->option; /* dump back option letter */
+	(void)pthread_cond_destroy(&a->change);
+	(void)pthread_mutex_destroy(&a->lock);
+	for (size_t i = 0; i < HEXY_NELEMS(a->b); i++)
+		free(a->b[i]);
 }
+#endif
 
-#ifdef HEXY_DEFINE_MAIN
-#define HEXY_UNIT_TESTS
+#ifndef HEXY_FOLLOW_SIZE
+#define HEXY_FOLLOW_SIZE (64 * 1024) /* largest read made when following a file */
 #endif
 
-#ifdef HEXY_UNIT_TESTS
-HEXY_API int hexy_unit_tests(void) {
-	for (size_t i = 0; i < 256; i++) {
-		if (hexy_isupper(hexy_tolower(i)))
-			return -1;
-		if (hexy_islower(hexy_toupper(i)))
-			return -1;
+/* Dump `f`, opened from `path`, and then whatever is appended to it as
+ * `tail -f` does, until `h->length` bytes have been dumped or something
+ * fails. The push interface keeps the address and the partial row between
+ * reads so only new bytes are formatted, and the output (`sink` if it is
+ * in use) is flushed whenever the end of the file is reached. Waiting for
+ * more is done on an inotify watch or kqueue event, not by polling, and the
+ * watch is made before the first read so no write can be missed. Only
+ * complete rows are output until the end. */
+HEXY_INTERNAL int hexy_follow(hexy_t *h, FILE *f, const char *path, hexy_sink_t *sink) {
+	assert(h);
+	assert(f);
+	assert(path);
+	assert(sink);
+#if defined(HEXY_FOLLOW)
+	const int fd = fileno(f);
+	if (fd < 0)
+		return HEXY_ELINE;
+#if defined(__linux__)
+	const int w = inotify_init1(IN_CLOEXEC);
+	if (w < 0)
+		return HEXY_ELINE;
+	if (inotify_add_watch(w, path, IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE) < 0)
+		goto fail;
+#else
+	const int w = kqueue();
+	if (w < 0)
+		return HEXY_ELINE;
+	struct kevent ev;
+	EV_SET(&ev, fd, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB, 0, NULL);
+	if (kevent(w, &ev, 1, NULL, 0, NULL) < 0)
+		goto fail;
+#endif
+	if (hexy_begin(h) < 0)
+		goto fail;
+	uint8_t b[HEXY_FOLLOW_SIZE];
+	for (uint64_t at = 0;;) {
+		errno = 0;
+		const ssize_t r = read(fd, b, sizeof (b));
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			goto fail;
+		if (r > 0) {
+			at += r;
+			h->io.read += r;
+			if (hexy_feed(h, b, r) < 0)
+				goto fail;
+			if (h->length && h->fed >= (h->offset + h->length))
+				break;
+			continue;
+		}
+		const int flushed = sink->b ? hexy_sink_flush(sink) : fflush((FILE*)h->io.out);
+		if (flushed < 0)
+			goto fail;
+		struct stat st;
+		if (fstat(fd, &st) < 0)
+			goto fail;
+		if ((uint64_t)st.st_size < at) {
+			(void)fprintf(stderr, "file truncated: %s\n", path);
+			goto fail;
+		}
+		if ((uint64_t)st.st_size > at) /* written to between the read and the check */
+			continue;
+#if defined(__linux__)
+		union { struct inotify_event e; char b[sizeof (struct inotify_event) + NAME_MAX + 1]; } events;
+		errno = 0;
+		if (read(w, &events, sizeof (events)) <= 0 && errno != EINTR)
+			goto fail;
+#else
+		struct kevent got;
+		errno = 0;
+		if (kevent(w, NULL, 0, &got, 1, NULL) < 0 && errno != EINTR)
+			goto fail;
+#endif
 	}
-
-	return 0;
-}
+	(void)close(w);
+	return hexy_finish(h);
+fail:
+	hexy_push_release(h);
+	(void)close(w);
+	return HEXY_ELINE;
 #else
-HEXY_API int hexy_unit_tests(void) {
-	/* Unit tests turned off, function still available */
-	return 0;
+	(void)path;
+	return HEXY_ELINE;
+#endif
 }
+
+#ifdef HEXY_STATS
+HEXY_INTERNAL uint64_t hexy_clock(void) { /* nanoseconds, from an arbitrary point */
+#if defined(HEXY_POSIX) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return ((uint64_t)ts.tv_sec * 1000000000ull) + ts.tv_nsec;
 #endif
+	return ((uint64_t)clock() * 1000000000ull) / CLOCKS_PER_SEC;
+}
 
-#ifdef HEXY_DEFINE_MAIN
+HEXY_INTERNAL int hexy_stats_print(const hexy_io_t *io, FILE *out) {
+	assert(io);
+	assert(out);
+	const hexy_stats_t *s = &io->stats;
+	const int r = fprintf(out,
+		"rows:     %llu (%llu squeezed)\n"
+		"bytes:    %llu formatted, %llu read, %llu written\n"
+		"calls:    %llu reads, %llu writes\n"
+		"time:     %.3fs in I/O, %.3fs formatting\n",
+		(unsigned long long)s->rows, (unsigned long long)s->squeezed,
+		(unsigned long long)s->bytes, (unsigned long long)io->read, (unsigned long long)io->wrote,
+		(unsigned long long)s->reads, (unsigned long long)s->writes,
+		s->io_time / 1e9, s->format_time / 1e9);
+	return r < 0 ? HEXY_ELINE : 0;
+}
+#endif
 
 HEXY_INTERNAL int hexy_help(FILE *out, const char *arg0, hexy_options_t *kv, size_t kvlen) {
 	assert(out);
 	assert(arg0);
-	const char *fmt = "Usage: %s [-bBng #] [-h] [-s string] files...\n\n\
+	const char *fmt = "Usage: %s [-bBngjSl #] [-h] [-s string] [-pP pattern] files...\n\n\
 Author:  " HEXY_AUTHOR "\n\
 Repo:    " HEXY_REPO "\n\
 Email:   " HEXY_EMAIL "\n\
@@ -945,7 +4788,10 @@ Version: " HEXY_VERSION "\n\n\
 A customizable hex-dump library and utility. This program returns zero\n\
 on success and non-zero on failure. If `-r` is specified and a multiple\n\
 of the bytes specified by `-g` is not provided then the last group is left\n\
-unreversed.\n\n\
+unreversed. Runs of identical rows are replaced with a single `*` line\n\
+unless `-o squeeze=off` is given. The `sep-*` strings may contain C style\n\
+escape sequences such as `\\t` and `\\x1b`. Other output formats can be\n\
+picked with `-o format=`, a C array is named after the file.\n\n\
 Options:\n\n\
 \t-h\tPrint this help message and exit.\n\
 \t-t\tRun built in self tests and exit (zero indicates success).\n\
@@ -953,10 +4799,20 @@ Options:\n\n\
 \t-B #\tSet base for address printing, uses same base as byte output if not set.\n\
 \t-n #\tSet number of columns of values to print out.\n\
 \t-g #\tGroup bytes together in the given number of bytes. (default = 1).\n\
+\t-j #\tUse up to this many threads to format files that can be mapped in.\n\
+\t-S #\tSkip this many bytes of each file, seeking past them if possible.\n\
+\t-l #\tDump at most this many bytes of each file (after skipping).\n\
 \t-s str\tPerform a hexdump on the given string and then exit.\n\
 \t-o k=v\tSet a number of key-value pair options.\n\
 \t-r\tReverse byte order, no effect if `-g` option is 1.\n\
 \t-R\tRaw mode; turn off printing everything except bytes.\n\
+\t-u\tUndump; turn a hex-dump made with the same options back into binary.\n\
+\t-d\tDiff; dump only the rows of two files that differ, returns 1 if any do.\n\
+\t-p hex\tSearch; dump only the rows containing the bytes given in hex, returns 1 if none do.\n\
+\t-P str\tSearch for a string, which may contain escape sequences, as with `-p`.\n\
+\t-f\tFollow; keep dumping what is appended to a single file, as `tail -f` does.\n\
+\t-w\tWords; print each group as one number, use `-r` for little endian words.\n\
+\t-v\tPrint statistics on rows, bytes, calls and where the time went to stderr.\n\
 \n\
 Options settable by `-o` flag:\n\n";
 	const int r1 = fprintf(out, fmt, arg0);
@@ -965,70 +4821,558 @@ Options settable by `-o` flag:\n\n";
 	return r1 < 0 || r2 < 0 || r3 != '\n' ? -1 : 0;
 }
 
+/* Name a C array after `path` the way `xxd -i` does, anything that cannot
+ * be in an identifier becomes an underscore. */
+HEXY_INTERNAL void hexy_c_name(char name[/*static HEXY_MAX_NAME + 1*/], const char *path) {
+	assert(name);
+	assert(path);
+	size_t i = 0;
+	if (hexy_isdigit(path[0]))
+		name[i++] = '_';
+	for (; *path && i < HEXY_MAX_NAME; path++) {
+		const int ch = *path;
+		name[i++] = hexy_isdigit(ch) || hexy_islower(ch) || hexy_isupper(ch) ? ch : '_';
+	}
+	if (!i)
+		name[i++] = '_';
+	name[i] = '\0';
+}
+
 HEXY_INTERNAL int hexy_sf(hexy_t *h, const char *in, FILE *out) {
 	assert(h);
 	assert(in);
 	assert(out);
 	hexy_buffer_t b = { .b = (unsigned char*)in, .length = strlen(in), };
-	hexy_io_t io = { .get = hexy_buffer_get, .put = hexy_file_put, .out = stdout, .in  = &b, };
+	hexy_io_t io = { .get = hexy_buffer_get, .put = hexy_file_put, .in  = &b, .out = stdout, .read_block = hexy_buffer_read, .write_block = hexy_file_write, };
 	h->io = io;
 	return hexy(h);
 }
 
+/* Run `hexy_diff` on two files, the output and options are taken from `h`
+ * and `io` holds the callbacks to use for files that cannot be mapped in.
+ * This returns 0 if they are the same, 1 if they differ and 2 on error,
+ * as `cmp` and `diff` do. */
+HEXY_INTERNAL int hexy_diff_files(hexy_t *h, const hexy_io_t *io, char *const paths[2], bool map_on, int context, bool fit) {
+	assert(h);
+	assert(io);
+	assert(paths);
+	FILE *f[2] = { NULL, NULL, };
+	hexy_map_t m[2] = { { .map = NULL, }, { .map = NULL, }, };
+	hexy_io_t in[2] = { h->io, *io, };
+	uint64_t most = 0;
+	bool sized = true;
+	int r = 2, d = 0;
+	for (int i = 0; i < 2; i++) {
+		errno = 0;
+		if (!(f[i] = fopen(paths[i], "rb"))) {
+			(void)fprintf(stderr, "Cannot open file %s (mode %s): %s\n", paths[i], "rb", strerror(errno));
+			goto done;
+		}
+		in[i].in = f[i];
+		in[i].get = io->get;
+		in[i].read_block = io->read_block;
+		in[i].seek = io->seek;
+		if (map_on && hexy_map(&m[i], f[i]) >= 0) {
+			in[i].in = &m[i].b;
+			in[i].get = hexy_buffer_get;
+			in[i].read_block = hexy_buffer_read;
+			in[i].seek = hexy_buffer_seek;
+		}
+		uint64_t size = 0;
+		sized = sized && hexy_file_size(f[i], &size) >= 0;
+		most = HEXY_MAX(most, size);
+	}
+	h->io = in[0];
+	if (fit)
+		h->awidth = sized ? hexy_address_width(h, most) : 0;
+	d = hexy_diff(h, &in[1], context);
+	if (d < 0)
+		(void)fprintf(stderr, "diff failed: %d\n", d);
+	r = d < 0 ? 2 : d > 0;
+done:
+	for (int i = 0; i < 2; i++) {
+		if (hexy_unmap(&m[i]) < 0)
+			r = 2;
+		if (f[i] && fclose(f[i]) < 0)
+			r = 2;
+	}
+	return r;
+}
+
+#ifndef HEXY_FILES_BUFFERED
+#define HEXY_FILES_BUFFERED (1024l * 1024l) /* largest file formatted ahead with `-o files=`, larger ones are only opened ahead */
+#endif
+
+#ifndef HEXY_MAX_FILES
+#define HEXY_MAX_FILES (256) /* most files that can be opened and formatted at once with `-o files=` */
+#endif
+
+typedef struct {
+	FILE *f;            /* NULL if the file could not be opened */
+	hexy_map_t m;       /* the file mapped in, if it could be */
+	char *out;          /* output, `used` bytes long, if `dumped` */
+	size_t used, read;  /* bytes of `out` used, bytes of input read */
+	uint64_t end;       /* address following the file, if `dumped` */
+	int state;          /* one of the `HEXY_SLOT_*_E` values */
+	int error,          /* `errno` from `fopen` */
+	    r,              /* these are set if `dumped`: result of dumping it... */
+	    unmapped,       /* ...of unmapping it... */
+	    closed,         /* ...and of closing it, with... */
+	    close_error;    /* ...`errno` from `fclose` */
+	bool dumped;        /* formatted and closed by a worker, otherwise it is left open to be dumped in turn */
+#ifdef HEXY_STATS
+	hexy_stats_t stats; /* formatting statistics for the file */
+#endif
+} hexy_file_t;          /* a file being dumped, it may have been opened and formatted ahead of its turn */
+
+#ifdef HEXY_THREADS
+/* Files given on the command line are opened, mapped in and (if small
+ * enough) formatted by a pool of workers, each into its own buffer, so
+ * waiting on `open` for one file overlaps with others. The output is
+ * written in argument order by the main thread and is the same as dumping
+ * the files one after another. As addresses carry on from file to file a
+ * worker has to wait for the end address of the file before its own, it is
+ * known from the size of a mapped in file, otherwise only once the main
+ * thread has dumped it. */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t change;
+	hexy_t h;                      /* configuration copied for each file, not modified */
+	char *const *paths;            /* files to dump, `count` of them */
+	const hexy_pattern_t *pattern; /* searched for if not NULL */
+	hexy_file_t *slots;            /* file `n` is in slot `n % nslots` */
+	pthread_t *ids;                /* workers, `started` of them */
+	size_t count, nslots,
+	       next,                   /* next file to be claimed by a worker */
+	       chain;                  /* files before this have had their end address worked out... */
+	uint64_t address;              /* ...which is the address file `chain` starts at */
+	int started, context;
+	bool map_on, fit, stop;
+} hexy_files_t;
+
+HEXY_INTERNAL void hexy_files_job(hexy_files_t *p, size_t n, hexy_file_t *s) {
+	assert(p);
+	assert(s);
+	errno = 0;
+	if (!(s->f = fopen(p->paths[n], "rb"))) {
+		s->error = errno;
+		return;
+	}
+	if (!p->map_on || hexy_map(&s->m, s->f) < 0 || s->m.b.length > HEXY_FILES_BUFFERED)
+		return;
+	hexy_t w = p->h;
+	const size_t length = s->m.b.length, skip = HEXY_MIN((uint64_t)length, w.offset);
+	const size_t dumped = w.length ? HEXY_MIN((uint64_t)(length - skip), w.length) : length - skip;
+	(void)pthread_mutex_lock(&p->lock);
+	while (p->chain != n && !p->stop)
+		(void)pthread_cond_wait(&p->change, &p->lock);
+	const bool stop = p->stop;
+	w.address = p->address;
+	s->end = p->address + w.offset + dumped;
+	if (!stop) {
+		p->address = s->end;
+		p->chain++;
+		(void)pthread_cond_broadcast(&p->change);
+	}
+	(void)pthread_mutex_unlock(&p->lock);
+	if (stop)
+		return;
+
+	char name[HEXY_MAX_NAME + 1] = { 0, };
+	hexy_c_name(name, p->paths[n]);
+	w.name = name;
+	if (p->fit)
+		w.awidth = hexy_address_width(&w, length);
+	s->dumped = true;
+	s->r = HEXY_ELINE;
+	if (hexy_config_default(&w) >= 0) {
+		const size_t rows = (length / (w.ncols * w.group)) + 2; /* and a line of "--" per row searching */
+		const size_t size = (rows * (hexy_line_max(&w) + 2 + w.sep.eol.length)) + HEXY_LINE_BUF_SIZE;
+		hexy_buffer_t out = { .b = (uint8_t*)(s->out = (char*)malloc(size)), .length = size, };
+		hexy_io_t io = { .get = hexy_buffer_get, .put = hexy_buffer_put, .in = &s->m.b, .out = &out, .read_block = hexy_buffer_read, .write_block = hexy_buffer_write, .seek = hexy_buffer_seek, };
+#ifdef HEXY_STATS
+		io.stats.clock = w.io.stats.clock;
+#endif
+		w.io = io;
+		if (s->out)
+			s->r = p->pattern ? hexy_search(&w, p->pattern, p->context) : hexy(&w);
+		hexy_implies(s->r >= 0, w.address == s->end);
+		s->used = out.used;
+		s->read = w.io.read;
+#ifdef HEXY_STATS
+		s->stats = w.io.stats;
+#endif
+	}
+	s->unmapped = hexy_unmap(&s->m);
+	errno = 0;
+	s->closed = fclose(s->f);
+	s->close_error = errno;
+}
+
+HEXY_INTERNAL void *hexy_files_worker(void *arg) {
+	hexy_files_t *p = (hexy_files_t*)arg;
+	assert(p);
+	(void)pthread_mutex_lock(&p->lock);
+	for (;;) {
+		if (p->stop || p->next >= p->count)
+			break;
+		const size_t n = p->next;
+		hexy_file_t *s = &p->slots[n % p->nslots];
+		if (s->state != HEXY_SLOT_FREE_E) {
+			(void)pthread_cond_wait(&p->change, &p->lock);
+			continue;
+		}
+		p->next++;
+		s->state = HEXY_SLOT_BUSY_E;
+		(void)pthread_mutex_unlock(&p->lock);
+		hexy_files_job(p, n, s);
+		(void)pthread_mutex_lock(&p->lock);
+		s->state = HEXY_SLOT_DONE_E;
+		(void)pthread_cond_broadcast(&p->change);
+	}
+	(void)pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+/* Start `threads` workers on `count` files, `h` must be set up as it is
+ * for dumping them one at a time. If no workers could be started negative
+ * is returned and the files should be dumped one at a time instead. */
+HEXY_INTERNAL int hexy_files_open(hexy_files_t *p, const hexy_t *h, char *const *paths, size_t count, int threads) {
+	assert(p);
+	assert(h);
+	assert(paths);
+	assert(threads > 1);
+	p->h = *h;
+	p->paths = paths;
+	p->count = count;
+	p->address = h->address;
+	p->nslots = threads * 2;
+	p->slots = (hexy_file_t*)calloc(p->nslots, sizeof (*p->slots));
+	p->ids = (pthread_t*)calloc(threads, sizeof (*p->ids));
+	if (!p->slots || !p->ids)
+		goto fail;
+	if (pthread_mutex_init(&p->lock, NULL))
+		goto fail;
+	if (pthread_cond_init(&p->change, NULL)) {
+		(void)pthread_mutex_destroy(&p->lock);
+		goto fail;
+	}
+	for (; p->started < threads; p->started++)
+		if (pthread_create(&p->ids[p->started], NULL, hexy_files_worker, p))
+			break;
+	if (p->started)
+		return 0;
+	(void)pthread_cond_destroy(&p->change);
+	(void)pthread_mutex_destroy(&p->lock);
+fail:
+	free(p->slots);
+	free(p->ids);
+	p->slots = NULL;
+	p->ids = NULL;
+	return HEXY_ELINE;
+}
+
+HEXY_INTERNAL hexy_file_t *hexy_files_wait(hexy_files_t *p, size_t n) {
+	assert(p);
+	assert(p->started);
+	hexy_file_t *s = &p->slots[n % p->nslots];
+	(void)pthread_mutex_lock(&p->lock);
+	while (s->state != HEXY_SLOT_DONE_E)
+		(void)pthread_cond_wait(&p->change, &p->lock);
+	(void)pthread_mutex_unlock(&p->lock);
+	return s;
+}
+
+/* Hand the slot of file `n` back once it has been dumped, `end` is the
+ * address following it, which is needed by the next file if it was
+ * dumped by the caller. */
+HEXY_INTERNAL void hexy_files_done(hexy_files_t *p, size_t n, uint64_t end) {
+	assert(p);
+	hexy_file_t *s = &p->slots[n % p->nslots];
+	free(s->out);
+	(void)pthread_mutex_lock(&p->lock);
+	if (p->chain == n) {
+		p->chain++;
+		p->address = end;
+	}
+	memset(s, 0, sizeof (*s));
+	s->state = HEXY_SLOT_FREE_E;
+	(void)pthread_cond_broadcast(&p->change);
+	(void)pthread_mutex_unlock(&p->lock);
+}
+
+HEXY_INTERNAL void hexy_files_close(hexy_files_t *p) {
+	assert(p);
+	if (!p->started)
+		return;
+	(void)pthread_mutex_lock(&p->lock);
+	p->stop = true;
+	(void)pthread_cond_broadcast(&p->change);
+	(void)pthread_mutex_unlock(&p->lock);
+	for (int i = 0; i < p->started; i++)
+		(void)pthread_join(p->ids[i], NULL);
+	for (size_t i = 0; i < p->nslots; i++) { /* files opened ahead that were not needed */
+		hexy_file_t *s = &p->slots[i];
+		if (s->state == HEXY_SLOT_DONE_E && !s->dumped && s->f) {
+			(void)hexy_unmap(&s->m);
+			(void)fclose(s->f);
+		}
+		free(s->out);
+	}
+	(void)pthread_cond_destroy(&p->change);
+	(void)pthread_mutex_destroy(&p->lock);
+	free(p->slots);
+	free(p->ids);
+	p->started = 0;
+}
+#endif
+
 int main(int argc, char **argv) {
-	hexy_io_t io = { .get = hexy_file_get, .put = hexy_file_put, .out = stdout, .in  = NULL, };
-	hexy_t hexy_s = { .init = false, }, *h = &hexy_s;
+	hexy_io_t io = { .get = hexy_file_get, .put = hexy_file_put, .in  = NULL, .out = stdout, .read_block = hexy_file_read, .write_block = hexy_file_write, .seek = hexy_file_seek, };
+	hexy_t hexy_s = { .init = false, .squeeze_on = true, }, *h = &hexy_s;
 	hexy_getopt_t opt = { .error = stderr, };
+	bool map_on = true, async_on = false, undump = false, stats = false, diff = false, search = false, follow = false;
+	hexy_pattern_t pattern = { .length = 0, };
+	char *format = NULL, name[HEXY_MAX_NAME + 1] = { 0, };
+	int jobs = 1;
+	long awidth = 0, bufsize = -1, context = 0, nfiles = 1;
 	hexy_options_t kv[] = {
-		{ .opt = "sep-eol",      .v.s = &h->sep_eol,       .type = HEXY_OPTIONS_STRING_E, .help = "Set string to print at the end of line", },
-		{ .opt = "sep-address",  .v.s = &h->sep_adr,       .type = HEXY_OPTIONS_STRING_E, .help = "Set string to print after printing address", },
-		{ .opt = "sep-bytes",    .v.s = &h->sep_byt,       .type = HEXY_OPTIONS_STRING_E, .help = "Set string to print in between printing bytes", },
-		{ .opt = "sep-ch1",      .v.s = &h->sep_ch1,       .type = HEXY_OPTIONS_STRING_E, .help = "Set string to print after bytes and before character view", },
-		{ .opt = "sep-ch2",      .v.s = &h->sep_ch2,       .type = HEXY_OPTIONS_STRING_E, .help = "Set string to print after character view and before newline", },
-		{ .opt = "chars-off",    .v.b = &h->chars_off,     .type = HEXY_OPTIONS_BOOL_E,   .help = "Turn character view off", },
-		{ .opt = "address-off",  .v.b = &h->addresses_off, .type = HEXY_OPTIONS_BOOL_E,   .help = "Turn address printing off", },
-		{ .opt = "newlines-off", .v.b = &h->newlines_off,  .type = HEXY_OPTIONS_BOOL_E,   .help = "Turn newline printing off", },
-		{ .opt = "uppercase",    .v.b = &h->uppercase_on,  .type = HEXY_OPTIONS_BOOL_E,   .help = "Turn on printing upcase hex values", },
-		{ .opt = "reverse",      .v.b = &h->rev_grp_on,    .type = HEXY_OPTIONS_BOOL_E,   .help = "Reverse the order of byte groups", },
+		{ .opt = "sep-eol",      .help = "Set string to print at the end of line", .v = { .s = &h->sep_eol }, .type = HEXY_OPTIONS_STRING_E, },
+		{ .opt = "sep-address",  .help = "Set string to print after printing address", .v = { .s = &h->sep_adr }, .type = HEXY_OPTIONS_STRING_E, },
+		{ .opt = "sep-bytes",    .help = "Set string to print in between printing bytes", .v = { .s = &h->sep_byt }, .type = HEXY_OPTIONS_STRING_E, },
+		{ .opt = "sep-ch1",      .help = "Set string to print after bytes and before character view", .v = { .s = &h->sep_ch1 }, .type = HEXY_OPTIONS_STRING_E, },
+		{ .opt = "sep-ch2",      .help = "Set string to print after character view and before newline", .v = { .s = &h->sep_ch2 }, .type = HEXY_OPTIONS_STRING_E, },
+		{ .opt = "chars-off",    .help = "Turn character view off", .v = { .b = &h->chars_off }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "address-off",  .help = "Turn address printing off", .v = { .b = &h->addresses_off }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "newlines-off", .help = "Turn newline printing off", .v = { .b = &h->newlines_off }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "uppercase",    .help = "Turn on printing upcase hex values", .v = { .b = &h->uppercase_on }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "reverse",      .help = "Reverse the order of byte groups", .v = { .b = &h->rev_grp_on }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "squeeze",      .help = "Print a single '*' line for runs of repeated rows", .v = { .b = &h->squeeze_on }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "words",        .help = "Print each group as a single number", .v = { .b = &h->words_on }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "color",        .help = "Colour bytes by class: NUL, printable, whitespace, control, high bit and 0xff", .v = { .b = &h->color_on }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "mmap",         .help = "Map regular files into memory instead of reading them", .v = { .b = &map_on }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "async",        .help = "Read files that are not mapped ahead of the formatter in another thread, off by default", .v = { .b = &async_on }, .type = HEXY_OPTIONS_BOOL_E, },
+		{ .opt = "address-width", .help = "Minimum width of addresses, 0 for the default, -1 to fit the size of each file", .v = { .n = &awidth }, .type = HEXY_OPTIONS_LONG_E, },
+		{ .opt = "format",       .help = "Output format; hexdump (the default), c, json, plain or od", .v = { .s = &format }, .type = HEXY_OPTIONS_STRING_E, },
+		{ .opt = "context",      .help = "Rows of context to print around differing or matching rows with `-d` or `-p`", .v = { .n = &context }, .type = HEXY_OPTIONS_LONG_E, },
+		{ .opt = "buffer",       .help = "Bytes of output to collect before writing, 0 uses stdio, -1 picks (the default)", .v = { .n = &bufsize }, .type = HEXY_OPTIONS_LONG_E, },
+		{ .opt = "files",        .help = "Open and format up to this many files at once, output is still in argument order", .v = { .n = &nfiles }, .type = HEXY_OPTIONS_LONG_E, },
 	};
 
-	for (int ch = 0; (ch = hexy_getopt(&opt, argc, argv, "hb#B#n#g#s:o:rRt")) != -1;) {
+	for (int ch = 0; (ch = hexy_getopt(&opt, argc, argv, "hb#B#n#g#j#S#l#s:o:p:P:dfrRtuvw")) != -1;) {
 		switch (ch) {
 		case 'h': return hexy_help(stderr, argv[0], &kv[0], HEXY_NELEMS(kv)) < 0;
 		case 'b': h->base = opt.narg; break;
 		case 'B': h->abase = opt.narg; break;
 		case 'n': h->ncols = opt.narg; break;
 		case 'g': h->group = opt.narg; break;
+		case 'j': jobs = opt.narg; break;
+		case 'S': if (opt.narg < 0) return 1; h->offset = opt.narg; break;
+		case 'l': if (opt.narg < 0) return 1; h->length = opt.narg; break;
+		case 'd': diff = true; break;
+		case 'f': follow = true; break;
+		case 'p':
+			if (hexy_pattern_hex(&pattern, opt.arg) < 0) {
+				(void)fprintf(stderr, "invalid hex pattern: %s\n", opt.arg);
+				return 2;
+			}
+			search = true;
+			break;
+		case 'P':
+			if (hexy_unescape(opt.arg, strlen(opt.arg) + 1) < 0 || hexy_pattern_make(&pattern, (uint8_t*)opt.arg, strlen(opt.arg)) < 0) {
+				(void)fprintf(stderr, "invalid pattern: %s\n", opt.arg);
+				return 2;
+			}
+			search = true;
+			break;
 		case 'r': h->rev_grp_on = true; break;
 		case 'R': h->chars_off = true; h->newlines_off = true; h->addresses_off = true; break;
-		case 'o': if (hexy_options_set(&kv[0], HEXY_NELEMS(kv), opt.arg, stderr) < 0) return 1; break;
+		case 'o':
+			if (hexy_options_set(&kv[0], HEXY_NELEMS(kv), opt.arg, stderr) < 0)
+				return 1;
+			if (format && (h->format = hexy_format_by_name(format)) < 0) {
+				(void)fprintf(stderr, "unknown format: %s\n", format);
+				return 1;
+			}
+			break;
 		case 's': if (hexy_sf(h, opt.arg, stdout) < 0) return 1; break;
 		case 't': return hexy_unit_tests() < 0;
+		case 'u': undump = true; break;
+		case 'v': stats = true; break;
+		case 'w': h->words_on = true; break;
 		default: return 1;
 		}
 	}
 
 	h->io = io; /* -s option sets I/O struct if used, it needs to be reset here. */
-	for (int i = opt.index; i < argc; i++) {
-		errno = 0;
-		FILE *f = fopen(argv[i], "rb");
-		if (!f) {
-			(void)fprintf(stderr, "Cannot open file %s (mode %s): %s\n", argv[i], "rb", strerror(errno));
+#ifdef HEXY_STATS
+	h->io.stats.clock = stats ? hexy_clock : NULL;
+#else
+	if (stats) {
+		(void)fprintf(stderr, "statistics not compiled in (HEXY_STATS)\n");
+		return 1;
+	}
+#endif
+	if (awidth < -1 || awidth > INT_MAX || bufsize < -1 || bufsize > INT_MAX || context < 0 || context > HEXY_MAX_CONTEXT)
+		return 1;
+	if (nfiles < 1 || nfiles > HEXY_MAX_FILES)
+		return 1;
+	if (diff && (undump || search || (argc - opt.index) != 2)) {
+		(void)fprintf(stderr, "-d needs two files to compare\n");
+		return 2;
+	}
+	if (search && undump) {
+		(void)fprintf(stderr, "-p and -P cannot be used with -u\n");
+		return 2;
+	}
+	if (follow && (undump || search || diff || (argc - opt.index) != 1)) {
+		(void)fprintf(stderr, "-f needs a single file to dump\n");
+		return 2;
+	}
+#ifndef HEXY_FOLLOW
+	if (follow) {
+		(void)fprintf(stderr, "-f is not supported on this system\n");
+		return 1;
+	}
+#endif
+	map_on = map_on && !follow; /* a mapping would only see what the file held when it was made */
+	h->awidth = awidth < 0 ? 0 : awidth;
+	if (bufsize < 0) { /* a terminal gets output as it is made */
+#if defined(HEXY_POSIX)
+		bufsize = isatty(fileno(stdout)) ? 0 : HEXY_SINK_DEFAULT;
+#else
+		bufsize = HEXY_SINK_DEFAULT;
+#endif
+	}
+	hexy_sink_t sink = { .b = NULL, };
+	if (bufsize) {
+		if (fflush(stdout) < 0 || hexy_sink_open(&sink, stdout, bufsize) < 0) {
+			(void)fprintf(stderr, "cannot allocate output buffer of %ld bytes\n", bufsize);
 			return 1;
 		}
-		h->io.in = f;
-		const int r = hexy(h);
-		errno = 0;
-		if (fclose(f) < 0) {
-			(void)fprintf(stderr, "fclose failed: %s\n", strerror(errno));
-			return 1;
+		h->io.out = &sink;
+		h->io.put = hexy_sink_put;
+		h->io.write_block = hexy_sink_write;
+	}
+	int status = diff ? hexy_diff_files(h, &io, &argv[opt.index], map_on, context, awidth < 0) : 0, matches = 0;
+	const int failure = search ? 2 : 1; /* searching returns 1 if nothing was found, as `grep` does */
+#ifdef HEXY_THREADS
+	hexy_files_t files = { .pattern = search ? &pattern : NULL, .context = (int)context, .map_on = map_on, .fit = awidth < 0, };
+	if (!diff && !undump && nfiles > 1 && (argc - opt.index) > 1) /* dumped one at a time if no threads can be started */
+		(void)hexy_files_open(&files, h, &argv[opt.index], argc - opt.index, (int)HEXY_MIN(nfiles, (long)(argc - opt.index)));
+#endif
+	for (int i = opt.index; !diff && i < argc; i++) {
+		hexy_file_t local = { .f = NULL, }, *fl = &local;
+#ifdef HEXY_THREADS
+		if (files.started) {
+			fl = hexy_files_wait(&files, i - opt.index);
+		} else
+#endif
+		{
+			errno = 0;
+			fl->f = fopen(argv[i], "rb");
+			fl->error = errno;
+			if (fl->f && map_on)
+				(void)hexy_map(&fl->m, fl->f);
+		}
+		if (!fl->f) {
+			(void)fprintf(stderr, "Cannot open file %s (mode %s): %s\n", argv[i], "rb", strerror(fl->error));
+			status = failure;
+			break;
+		}
+		if (fl->dumped) { /* formatted ahead, only its output is left to write */
+			if (fl->r >= 0 && hexy_write(&h->io, fl->out, fl->used) < 0)
+				fl->r = HEXY_ELINE;
+			h->address = fl->end;
+			h->io.read += fl->read;
+#ifdef HEXY_STATS
+			h->io.stats.rows        += fl->stats.rows;
+			h->io.stats.squeezed    += fl->stats.squeezed;
+			h->io.stats.bytes       += fl->stats.bytes;
+			h->io.stats.reads       += fl->stats.reads;
+			h->io.stats.io_time     += fl->stats.io_time;
+			h->io.stats.format_time += fl->stats.format_time;
+#endif
+		} else {
+			FILE *f = fl->f;
+			hexy_map_t *m = &fl->m;
+			hexy_c_name(name, argv[i]);
+			h->name = name;
+			h->io.in = f;
+			h->io.get = io.get;
+			h->io.read_block = io.read_block;
+			h->io.seek = io.seek;
+			if (m->map) {
+				h->io.in = &m->b;
+				h->io.get = hexy_buffer_get;
+				h->io.read_block = hexy_buffer_read;
+				h->io.seek = hexy_buffer_seek;
+			}
+#ifdef HEXY_THREADS
+			hexy_async_t a = { .fd = -1, };
+			const bool async = async_on && !follow && !m->map && hexy_async_open(&a, f) >= 0;
+			if (async) {
+				h->io.in = &a;
+				h->io.get = hexy_async_get;
+				h->io.read_block = hexy_async_read;
+				h->io.seek = hexy_async_seek;
+			}
+#endif
+			uint64_t size = 0;
+			if (awidth < 0 && !undump) /* the default width is used if the size is not known */
+				h->awidth = hexy_file_size(f, &size) < 0 ? 0 : hexy_address_width(h, size);
+#ifdef HEXY_THREADS
+			fl->r = undump ? hexy_undump(h) : search ? hexy_search(h, &pattern, context) : follow ? hexy_follow(h, f, argv[i], &sink) :
+				m->map && jobs > 1 ? hexy_parallel(h, m->b.b, m->b.length, jobs) : hexy(h);
+			if (async)
+				hexy_async_close(&a);
+#else
+			fl->r = undump ? hexy_undump(h) : search ? hexy_search(h, &pattern, context) : follow ? hexy_follow(h, f, argv[i], &sink) : hexy(h);
+			(void)jobs;
+			(void)async_on;
+			(void)nfiles;
+#endif
+			fl->unmapped = hexy_unmap(m);
+			errno = 0;
+			fl->closed = fclose(f);
+			fl->close_error = errno;
+		}
+		const int r = fl->r, unmapped = fl->unmapped, closed = fl->closed, close_error = fl->close_error;
+#ifdef HEXY_THREADS
+		if (files.started)
+			hexy_files_done(&files, i - opt.index, h->address);
+#endif
+		if (unmapped < 0) {
+			(void)fprintf(stderr, "unmap failed: %s\n", argv[i]);
+			status = failure;
+			break;
+		}
+		if (closed < 0) {
+			(void)fprintf(stderr, "fclose failed: %s\n", strerror(close_error));
+			status = failure;
+			break;
 		}
 		if (r < 0) {
 			(void)fprintf(stderr, "hexdump failed: %d\n", r);
-			return 1;
+			status = failure;
+			break;
 		}
+		matches += search && r > 0;
 	}
-	return 0;
+#ifdef HEXY_THREADS
+	hexy_files_close(&files);
+#endif
+	if (search && !status && !matches)
+		status = 1;
+	if (hexy_sink_close(&sink) < 0) {
+		(void)fprintf(stderr, "write failed: %s\n", strerror(errno));
+		status = failure;
+	}
+#ifdef HEXY_STATS
+	if (stats && hexy_stats_print(&h->io, stderr) < 0)
+		return 1;
+#endif
+	return status;
 }
 
 #endif /* HEXY_DEFINE_MAIN */